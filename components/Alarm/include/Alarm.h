@@ -1,9 +1,64 @@
 #pragma once
 #include <time.h>
-#include "Settings.h"
+#include <span>
+#include <vector>
+#include "SettingsTypes.h"
+#include "TimeZone.h"
 
 namespace Alarm {
-    void init();
-    bool obtain_time(int timeout_sec = 30);
-    bool is_alarm_time(const SunriseSettings &settings, double &sunrise_percentage);
+    // One sunrise occurrence in epoch milliseconds: the ramp runs from start to full,
+    // then the light holds at full brightness until end (duration_on_brightest)
+    struct SunrisePlan {
+        int64_t start_ms;
+        int64_t full_ms;
+        int64_t end_ms;
+    };
+
+    enum SunrisePhase {
+        SUNRISE_IDLE,
+        SUNRISE_RAMP,
+        SUNRISE_HOLD,
+    };
+
+    // Starts SNTP and returns; on_time_set runs in the SNTP task after each sync
+    void init(void (*on_time_set)() = nullptr);
+    // Sets TZ from the timezone setting if it changed since the last call
+    void apply_timezone();
+    // Sunrise progress is Q16 fixed point: 0 at the start of the ramp, 65535 at the end
+    uint16_t sunrise_progress(int64_t now_ms, int64_t start_ms, int64_t end_ms);
+    SunrisePhase sunrise_phase(const SunrisePlan &plan, int64_t now_ms);
+    // Next phase change after now_ms: the start, full brightness or the end
+    int64_t next_transition(const SunrisePlan &plan, int64_t now_ms);
+
+    // The daily alarm of the sunrise settings as a schedule entry
+    AlarmEntry daily_alarm(const SunriseSettings &settings);
+    // The occurrence of the alarm running at now_ms, or else the next one within a week.
+    // false if the alarm is disabled or has no weekday.
+    bool next_occurrence(const AlarmEntry &alarm, int64_t now_ms, SunrisePlan &plan, TimeZone &zone);
+
+    // Alarms in a min-heap by the start of their next occurrence. The head is the
+    // sunrise running now or the next one, so the renderer only looks at the head and
+    // an alarm is only recomputed (localtime/mktime) when its occurrence is over.
+    class Schedule {
+    public:
+        void rebuild(std::span<const AlarmEntry> alarms, int64_t now_ms);
+        // Replaces the occurrences that ended by now_ms with their next ones
+        void advance(int64_t now_ms);
+
+        bool empty() const { return heap_.empty(); }
+        const SunrisePlan &plan() const { return heap_.front().plan; }
+        const AlarmEntry &alarm() const { return alarms_[heap_.front().index]; }
+        TimeZone &zone() { return zone_; }
+
+    private:
+        struct Node {
+            SunrisePlan plan;
+            int index;
+        };
+        std::vector<AlarmEntry> alarms_;
+        std::vector<Node> heap_;
+        TimeZone zone_;
+
+        static bool later(const Node &a, const Node &b);
+    };
 }
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+// UTC offsets of the configured timezone as a small transition table. Building it parses
+// the TZ rules through localtime_r a few hundred times; afterwards converting between
+// epoch and local time is a table lookup until the window runs out (about a year) or
+// the timezone setting changes. Not thread safe, every user keeps its own instance.
+class TimeZone {
+public:
+    static constexpr int64_t kDayMs = 24LL * 3600 * 1000;
+    static constexpr int kMaxTransitions = 4;
+
+    // Seconds east of UTC at epoch_ms
+    int32_t offset_s(int64_t epoch_ms);
+    int64_t to_local(int64_t epoch_ms) { return epoch_ms + offset_s(epoch_ms) * 1000LL; }
+    // Local wall time to epoch. Times in the hour skipped by a DST change move forward,
+    // in the repeated hour the first occurrence wins.
+    int64_t to_epoch(int64_t local_ms);
+
+    uint32_t rebuilds() const { return rebuilds_; }
+
+    // Offset from the C library, the slow reference
+    static int32_t utc_offset(time_t t);
+
+private:
+    struct Transition {
+        int64_t at_ms;
+        int32_t offset_s; // from at_ms on
+    };
+
+    int64_t from_ms_ = 0;
+    int64_t until_ms_ = 0;
+    int32_t base_offset_s_ = 0; // before the first transition
+    Transition transitions_[kMaxTransitions] = {};
+    int count_ = 0;
+    uint32_t revision_ = 0;
+    bool built_ = false;
+    uint32_t rebuilds_ = 0;
+
+    void build(int64_t epoch_ms);
+
+    // The timezone setting: its revision, and putting it into TZ. Implemented in Alarm.cpp;
+    // the host tools provide their own and set TZ themselves.
+    static uint32_t setting_revision();
+    static void apply_setting();
+};
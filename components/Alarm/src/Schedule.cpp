@@ -0,0 +1,89 @@
+#include "Alarm.h"
+#include <algorithm>
+
+// Sunrise planning: pure functions of the alarm and the time, also built by the host tools
+
+namespace Alarm {
+
+uint16_t sunrise_progress(int64_t now_ms, int64_t start_ms, int64_t end_ms) {
+    if (now_ms <= start_ms)
+        return 0;
+    if (now_ms >= end_ms)
+        return 65535;
+    // The ESP32 FPU is single precision only, stay in integers
+    return static_cast<uint16_t>((now_ms - start_ms) * 65535 / (end_ms - start_ms));
+}
+
+AlarmEntry daily_alarm(const SunriseSettings &settings) {
+    AlarmEntry alarm;
+    alarm.hour = static_cast<uint8_t>(settings.alarm_hour);
+    alarm.minute = static_cast<uint8_t>(settings.alarm_minute);
+    alarm.weekdays = 0x7F;
+    alarm.duration_minutes = static_cast<uint8_t>(std::clamp(settings.duration_minutes, 0, 255));
+    alarm.duration_on_brightest = static_cast<uint8_t>(std::clamp(settings.duration_on_brightest, 0, 255));
+    return alarm;
+}
+
+bool next_occurrence(const AlarmEntry &alarm, int64_t now_ms, SunrisePlan &plan, TimeZone &zone) {
+    if (!alarm.enabled || !(alarm.weekdays & 0x7F))
+        return false;
+
+    int64_t local_ms = zone.to_local(now_ms);
+    int64_t today = local_ms / TimeZone::kDayMs - (local_ms % TimeZone::kDayMs < 0);
+
+    // Yesterday's sunrise may still be running after midnight, otherwise the next day with
+    // its weekday bit set. Local days are plain arithmetic, DST is in the zone's offsets.
+    for (int64_t day = today - 1; day <= today + 7; day++) {
+        int weekday = static_cast<int>(((day + 4) % 7 + 7) % 7); // 1970-01-01 was a Thursday
+        if (!(alarm.weekdays & (1 << weekday)))
+            continue;
+        plan.start_ms = zone.to_epoch(day * TimeZone::kDayMs + (alarm.hour * 60 + alarm.minute) * 60 * 1000LL);
+        plan.full_ms = plan.start_ms + static_cast<int64_t>(alarm.duration_minutes) * 60 * 1000;
+        plan.end_ms = plan.full_ms + static_cast<int64_t>(alarm.duration_on_brightest) * 60 * 1000;
+        if (now_ms < plan.end_ms)
+            return true;
+    }
+    return false;
+}
+
+bool Schedule::later(const Node &a, const Node &b) {
+    return a.plan.start_ms > b.plan.start_ms;
+}
+
+void Schedule::rebuild(std::span<const AlarmEntry> alarms, int64_t now_ms) {
+    alarms_.assign(alarms.begin(), alarms.end());
+    heap_.clear();
+    for (size_t i = 0; i < alarms_.size(); i++) {
+        Node node{{}, static_cast<int>(i)};
+        if (next_occurrence(alarms_[i], now_ms, node.plan, zone_))
+            heap_.push_back(node);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), later);
+}
+
+void Schedule::advance(int64_t now_ms) {
+    while (!heap_.empty() && heap_.front().plan.end_ms <= now_ms) {
+        std::pop_heap(heap_.begin(), heap_.end(), later);
+        Node &node = heap_.back();
+        if (next_occurrence(alarms_[node.index], now_ms, node.plan, zone_))
+            std::push_heap(heap_.begin(), heap_.end(), later);
+        else
+            heap_.pop_back();
+    }
+}
+
+SunrisePhase sunrise_phase(const SunrisePlan &plan, int64_t now_ms) {
+    if (now_ms < plan.start_ms || now_ms >= plan.end_ms)
+        return SUNRISE_IDLE;
+    return now_ms < plan.full_ms ? SUNRISE_RAMP : SUNRISE_HOLD;
+}
+
+int64_t next_transition(const SunrisePlan &plan, int64_t now_ms) {
+    if (now_ms < plan.start_ms)
+        return plan.start_ms;
+    if (now_ms < plan.full_ms)
+        return plan.full_ms;
+    return plan.end_ms;
+}
+
+}
@@ -0,0 +1,91 @@
+#include "TimeZone.h"
+#include <algorithm>
+
+// Covers yesterday's sunrise from a lookup and a year ahead
+#define TIMEZONE_WINDOW_BEFORE_MS (8 * TimeZone::kDayMs)
+#define TIMEZONE_WINDOW_MS (400 * TimeZone::kDayMs)
+// DST changes are months apart, a week step cannot jump over two of them
+#define TIMEZONE_SCAN_STEP_S (7 * 24 * 3600)
+
+static int64_t days_from_civil(int64_t y, int64_t m, int64_t d)
+{
+    // Proleptic Gregorian calendar, days since 1970-01-01
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+int32_t TimeZone::utc_offset(time_t t)
+{
+    struct tm local;
+    localtime_r(&t, &local);
+    int64_t local_s = days_from_civil(local.tm_year + 1900LL, local.tm_mon + 1, local.tm_mday) * 86400 +
+                      local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+    return static_cast<int32_t>(local_s - t);
+}
+
+void TimeZone::build(int64_t epoch_ms)
+{
+    apply_setting();
+    revision_ = setting_revision();
+    built_ = true;
+    rebuilds_++;
+
+    from_ms_ = epoch_ms - TIMEZONE_WINDOW_BEFORE_MS;
+    until_ms_ = from_ms_ + TIMEZONE_WINDOW_MS;
+    count_ = 0;
+
+    time_t from = static_cast<time_t>(from_ms_ / 1000);
+    time_t until = static_cast<time_t>(until_ms_ / 1000);
+    base_offset_s_ = utc_offset(from);
+
+    int32_t offset = base_offset_s_;
+    for (time_t lo = from; lo < until && count_ < kMaxTransitions; lo += TIMEZONE_SCAN_STEP_S)
+    {
+        time_t hi = lo + TIMEZONE_SCAN_STEP_S;
+        int32_t hi_offset = utc_offset(hi);
+        if (hi_offset == offset)
+            continue;
+
+        // The change happens in (lo, hi], find its first second
+        time_t a = lo, b = hi;
+        while (b - a > 1)
+        {
+            time_t mid = a + (b - a) / 2;
+            if (utc_offset(mid) == offset)
+                a = mid;
+            else
+                b = mid;
+        }
+        transitions_[count_++] = {static_cast<int64_t>(b) * 1000, hi_offset};
+        offset = hi_offset;
+    }
+}
+
+int32_t TimeZone::offset_s(int64_t epoch_ms)
+{
+    if (!built_ || epoch_ms < from_ms_ || epoch_ms >= until_ms_ || revision_ != setting_revision())
+        build(epoch_ms);
+
+    int32_t offset = base_offset_s_;
+    for (int i = 0; i < count_ && epoch_ms >= transitions_[i].at_ms; i++)
+        offset = transitions_[i].offset_s;
+    return offset;
+}
+
+int64_t TimeZone::to_epoch(int64_t local_ms)
+{
+    // The offsets in force a day before and after; DST changes are never closer together
+    int64_t before_ms = local_ms - offset_s(local_ms - kDayMs) * 1000LL;
+    int64_t after_ms = local_ms - offset_s(local_ms + kDayMs) * 1000LL;
+    bool before_valid = to_local(before_ms) == local_ms;
+    bool after_valid = to_local(after_ms) == local_ms;
+    if (before_valid != after_valid)
+        return before_valid ? before_ms : after_ms;
+    // Both: the repeated hour in autumn, take the first. Neither: the hour skipped in
+    // spring, move forward.
+    return before_valid ? std::min(before_ms, after_ms) : std::max(before_ms, after_ms);
+}
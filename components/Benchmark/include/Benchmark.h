@@ -0,0 +1,8 @@
+#pragma once
+#include "Settings.h"
+
+// On-target micro benchmarks, enabled with CONFIG_SUNRISE_BENCHMARK.
+// They run once at boot before the LED strip is created and only log results.
+namespace Benchmark {
+    void run(const LowLevelSettings &settings);
+}
@@ -0,0 +1,381 @@
+#include "Benchmark.h"
+#include "Alarm.h"
+#include "LEDStrip.h"
+#include "Perceptual.h"
+#include "Snapshot.h"
+#include "SpatialKernel.h"
+#include "led_strip.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include <algorithm>
+#include <ctime>
+#include <vector>
+
+static const char *TAG = "Benchmark";
+
+namespace Benchmark {
+
+static constexpr int kIterations = 20;
+
+struct Result {
+    int64_t us;
+    uint32_t cycles;
+};
+
+template <typename F>
+static Result measure(F &&body) {
+    int64_t start_us = esp_timer_get_time();
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    for (int i = 0; i < kIterations; i++)
+        body(i);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start_cycles;
+    int64_t us = esp_timer_get_time() - start_us;
+    return {us / kIterations, cycles / kIterations};
+}
+
+// items: pixels per frame, or evaluations per iteration
+static void report(const char *name, const Result &r, int items) {
+    ESP_LOGI(TAG, "%-24s %7lld us/frame %6lu cycles/item", name, static_cast<long long>(r.us),
+             static_cast<unsigned long>(items > 0 ? r.cycles / items : 0));
+}
+
+static void led_writes(const LowLevelSettings &settings) {
+    const int n = settings.num_leds;
+    ESP_LOGI(TAG, "LED buffer writes, %d LEDs, %d iterations", n, kIterations);
+
+    // Reference: the per-pixel path through the led_strip component
+    {
+        led_strip_config_t strip_config = {};
+        strip_config.strip_gpio_num = settings.pin_led;
+        strip_config.max_leds = n;
+        strip_config.led_model = LED_MODEL_WS2812;
+        strip_config.color_component_format = LED_STRIP_COLOR_COMPONENT_FMT_GRB;
+        led_strip_rmt_config_t rmt_config = {};
+        rmt_config.clk_src = RMT_CLK_SRC_DEFAULT;
+        rmt_config.resolution_hz = 10 * 1000 * 1000;
+
+        led_strip_handle_t handle;
+        if (led_strip_new_rmt_device(&strip_config, &rmt_config, &handle) == ESP_OK) {
+            report("led_strip_set_pixel", measure([&](int it) {
+                for (int i = 0; i < n; i++)
+                    ESP_ERROR_CHECK(led_strip_set_pixel(handle, i, it, 120, 150));
+            }), n);
+            led_strip_del(handle);
+        }
+    }
+
+    LEDStrip strip(settings.pin_led, n);
+    std::vector<Rgb> frame(n);
+    for (int i = 0; i < n; i++)
+        frame[i] = {static_cast<uint8_t>(i), 120, 150};
+
+    report("LEDStrip::setPixel", measure([&](int it) {
+        for (int i = 0; i < n; i++)
+            strip.setPixel(i, it, 120, 150);
+    }), n);
+    report("LEDStrip::fill", measure([&](int it) { strip.fill(it, 120, 150); }), n);
+    report("LEDStrip::fillRange", measure([&](int it) { strip.fillRange(n / 4, n / 2, it, 120, 150); }), n / 2);
+    report("LEDStrip::writeFrame", measure([&](int) { strip.writeFrame(frame); }), n);
+}
+
+static void color_pipeline(const LowLevelSettings &settings) {
+    const int n = settings.num_leds;
+    ESP_LOGI(TAG, "16-bit colour pipeline, %d LEDs, %d iterations", n, kIterations);
+
+    volatile uint32_t sink = 0;
+    report("Perceptual::to_linear", measure([&](int it) {
+        for (int i = 0; i < n; i++)
+            sink = sink + Perceptual::to_linear(static_cast<uint16_t>(i * 7 + it));
+    }), n);
+
+    LEDStrip strip(settings.pin_led, n);
+    const Rgb16 color{12345, 2345, 345};
+    report("fill(Rgb16)", measure([&](int) { strip.fill(color); }), n);
+    strip.setDithering(true);
+    report("finalize, dithered", measure([&](int) { strip.fill(color); strip.finalize(); }), n);
+    const uint8_t gains[] = {255, 230, 200, 240, 255, 210};
+    strip.setCalibration(gains);
+    report("finalize, calibrated", measure([&](int) { strip.fill(color); strip.finalize(); }), n);
+    strip.setCalibration({});
+    strip.setDithering(false);
+    report("finalize, rounded", measure([&](int) { strip.fill(color); strip.finalize(); }), n);
+}
+
+static void spatial_kernel(const LowLevelSettings &settings) {
+    // 3000 LEDs at 60 fps leaves 16.6 ms per frame for everything
+    for (int n : {static_cast<int>(settings.num_leds), 3000}) {
+        ESP_LOGI(TAG, "Spatial kernel, %d LEDs, %d iterations", n, kIterations);
+        std::vector<Rgb16> frame(n);
+        const Rgb16 color{60000, 30000, 9000};
+        report("SpatialKernel from end", measure([&](int it) {
+            SpatialKernel::render(frame, SPATIAL_FROM_END, static_cast<uint16_t>(it * 3000), color);
+        }), n);
+        report("SpatialKernel from center", measure([&](int it) {
+            SpatialKernel::render(frame, SPATIAL_FROM_CENTER, static_cast<uint16_t>(it * 3000), color);
+        }), n);
+    }
+}
+
+// Spin rate of this task while idle vs while a frame is on the wire; the difference is
+// the CPU the transmission takes away on this core (refill interrupts, DMA bookkeeping).
+static uint32_t spin_rate(int64_t duration_us, LEDStrip *strip) {
+    uint32_t spins = 0;
+    int64_t start = esp_timer_get_time();
+    int64_t now = start;
+    while (strip ? strip->busy() : now - start < duration_us) {
+        spins++;
+        now = esp_timer_get_time();
+    }
+    return now > start ? static_cast<uint32_t>(spins * 1000LL / (now - start)) : 0;
+}
+
+static void fixed_point() {
+    // Bit-exactness against the reference is checked on the host, see
+    // tools/sunrise_progress_check.cpp. Here only the cost.
+    constexpr int kEvaluations = 1000;
+    const int64_t start = 1700000000000LL, end = start + 30 * 60 * 1000LL;
+    volatile uint32_t sink = 0;
+    volatile int64_t now = start;
+    report("progress, double", measure([&](int) {
+        for (int i = 0; i < kEvaluations; i++) {
+            double percentage = static_cast<double>(now + i * 1000 - start) / (end - start);
+            sink = sink + static_cast<uint16_t>(std::clamp(percentage, 0.0, 1.0) * 65535.0);
+        }
+    }), kEvaluations);
+    report("progress, Q16", measure([&](int) {
+        for (int i = 0; i < kEvaluations; i++)
+            sink = sink + Alarm::sunrise_progress(now + i * 1000, start, end);
+    }), kEvaluations);
+}
+
+// Local midnight through mktime, the C library reference
+static int64_t local_ms(int year, int month, int day) {
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_isdst = -1;
+    return static_cast<int64_t>(mktime(&t)) * 1000;
+}
+
+// TimeZone against localtime_r/mktime every 15 minutes of a year, and the cost of both
+static void timezone() {
+    const int64_t start = local_ms(2026, 1, 1), end = local_ms(2027, 1, 1);
+    const int64_t step = 15 * 60 * 1000;
+    TimeZone zone;
+    uint32_t checked = 0, mismatches = 0;
+    for (int64_t t = start; t < end; t += step) {
+        time_t at = static_cast<time_t>(t / 1000);
+        int64_t local = zone.to_local(t);
+        if (local - t != TimeZone::utc_offset(at) * 1000LL)
+            mismatches++;
+        // Round trip; in the repeated hour in autumn the first of the two instants
+        bool repeated = TimeZone::utc_offset(at - 3600) > TimeZone::utc_offset(at);
+        if (zone.to_epoch(local) != (repeated ? t - 3600 * 1000LL : t))
+            mismatches++;
+        checked++;
+    }
+    if (mismatches)
+        ESP_LOGE(TAG, "TimeZone: %lu of %lu conversions differ from the C library",
+                 static_cast<unsigned long>(mismatches), static_cast<unsigned long>(checked));
+    else
+        ESP_LOGI(TAG, "TimeZone: %lu conversions match the C library, %lu table builds",
+                 static_cast<unsigned long>(checked), static_cast<unsigned long>(zone.rebuilds()));
+
+    constexpr int kEvaluations = 100;
+    volatile int64_t sink = 0;
+    report("localtime_r", measure([&](int it) {
+        for (int i = 0; i < kEvaluations; i++) {
+            time_t at = static_cast<time_t>(start / 1000) + (it * kEvaluations + i) * 600;
+            struct tm parts;
+            localtime_r(&at, &parts);
+            sink = sink + parts.tm_hour;
+        }
+    }), kEvaluations);
+    report("TimeZone::to_local", measure([&](int it) {
+        for (int i = 0; i < kEvaluations; i++)
+            sink = sink + zone.to_local(start + (it * kEvaluations + i) * 600000LL);
+    }), kEvaluations);
+}
+
+// The cost of stepping the schedule from one sunrise to the next over a year. Whether
+// the sunrises are right is checked on the host, see tools/alarm_schedule_check.cpp.
+static void schedule() {
+    std::vector<AlarmEntry> alarms(4);
+    alarms[0].hour = 6, alarms[0].minute = 30, alarms[0].weekdays = 0x3E;  // Mon-Fri
+    alarms[1].hour = 2, alarms[1].minute = 30, alarms[1].weekdays = 0x01;  // Sun, inside both DST changes
+    alarms[2].hour = 23, alarms[2].minute = 50, alarms[2].weekdays = 0x7F; // across midnight
+    alarms[3].hour = 9, alarms[3].minute = 0, alarms[3].weekdays = 0x40;   // Sat
+
+    const int64_t year_start = local_ms(2026, 1, 1), year_end = local_ms(2027, 1, 1);
+    uint32_t steps = 0;
+    int64_t advance_cycles = 0;
+    Alarm::Schedule schedule;
+    schedule.rebuild(alarms, year_start);
+    while (!schedule.empty() && schedule.plan().start_ms < year_end) {
+        int64_t now = schedule.plan().end_ms;
+        uint32_t start_cycles = esp_cpu_get_cycle_count();
+        schedule.advance(now);
+        advance_cycles += esp_cpu_get_cycle_count() - start_cycles;
+        steps++;
+    }
+    ESP_LOGI(TAG, "Alarm schedule: %lu sunrises over 2026, advance %lu cycles", static_cast<unsigned long>(steps),
+             static_cast<unsigned long>(steps ? advance_cycles / steps : 0));
+}
+
+struct Transfer {
+    int64_t refresh_us;
+    int64_t present_us;
+    uint32_t cpu_percent;
+};
+
+// Sends kIterations frames and waits for each; vary changes the frame every time,
+// otherwise the same frame is re-sent as on a forced re-sync.
+static Transfer transfer(LEDStrip &strip, uint32_t idle_rate, bool vary) {
+    int64_t present_us = 0;
+    uint64_t busy_rate = 0;
+    strip.fill(10, 120, 150);
+    Result refresh = measure([&](int it) {
+        if (vary)
+            strip.fill(it, 120, 150);
+        int64_t start = esp_timer_get_time();
+        strip.present(true);
+        present_us += esp_timer_get_time() - start;
+        busy_rate += spin_rate(0, &strip);
+    });
+    uint32_t free_percent = idle_rate ? std::min<uint32_t>(100, busy_rate / kIterations * 100 / idle_rate) : 100;
+    return {refresh.us, present_us / kIterations, 100 - free_percent};
+}
+
+static void backends(const LowLevelSettings &settings) {
+    static const char *const kNames[] = {"RMT", "RMT + DMA", "SPI + DMA"};
+    const int n = settings.num_leds;
+    ESP_LOGI(TAG, "LED backends, %d LEDs, %d iterations", n, kIterations);
+
+    const uint32_t idle_rate = spin_rate(20000, nullptr);
+    for (LedBackend backend : {LED_BACKEND_RMT, LED_BACKEND_RMT_DMA, LED_BACKEND_SPI_DMA}) {
+        size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        size_t dma_before = heap_caps_get_free_size(MALLOC_CAP_DMA);
+        LEDStrip strip(settings.pin_led, n, backend);
+        size_t heap_used = heap_before - heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        size_t dma_used = dma_before - heap_caps_get_free_size(MALLOC_CAP_DMA);
+        if (strip.backend() != backend) {
+            ESP_LOGI(TAG, "%-10s not available", kNames[backend]);
+            continue;
+        }
+
+        Transfer t = transfer(strip, idle_rate, true);
+        ESP_LOGI(TAG, "%-10s refresh %6lld us, present %5lld us, CPU %3lu%% while sending, heap %6u B, DMA heap %6u B",
+                 kNames[backend], static_cast<long long>(t.refresh_us), static_cast<long long>(t.present_us),
+                 static_cast<unsigned long>(t.cpu_percent), static_cast<unsigned>(heap_used), static_cast<unsigned>(dma_used));
+
+        // Repeated frame from the encoded buffers; SPI always keeps them, RMT needs the symbol cache
+        if (backend == LED_BACKEND_SPI_DMA || strip.setSymbolCache(true)) {
+            t = transfer(strip, idle_rate, false);
+            ESP_LOGI(TAG, "%-10s repeated frame: refresh %6lld us, present %5lld us, CPU %3lu%%, symbol cache %6u B",
+                     kNames[backend], static_cast<long long>(t.refresh_us), static_cast<long long>(t.present_us),
+                     static_cast<unsigned long>(t.cpu_percent), static_cast<unsigned>(strip.symbolCacheBytes()));
+        }
+    }
+}
+
+// Low-level settings save: the old whole-struct blob against per-field diff writes. Runs
+// in its own namespace and removes it again; each save includes the commit.
+static void settings_storage(const LowLevelSettings &settings) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open("bench", NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        ESP_LOGW(TAG, "Settings storage: NVS not available");
+        return;
+    }
+    ESP_LOGI(TAG, "Settings save, %u byte struct, %d iterations", static_cast<unsigned>(sizeof(settings)), kIterations);
+
+    LowLevelSettings current = settings, stored = settings;
+    Result blob = measure([&](int) {
+        current.refresh_time++;
+        nvs_set_blob(nvs_handle, "lls", &current, sizeof(current));
+        nvs_commit(nvs_handle);
+    });
+    nvs_erase_key(nvs_handle, "lls");
+
+    auto fields = [&](auto &&change) {
+        return measure([&](int) {
+            change();
+            if (Settings::writeChangedFields(nvs_handle, current, stored) > 0)
+                nvs_commit(nvs_handle);
+            stored = current;
+        });
+    };
+    Settings::writeChangedFields(nvs_handle, current, stored, true);
+    Result all = fields([&] {
+        current.sunrise_red++, current.sunrise_green++, current.sunrise_blue++;
+        current.num_leds++, current.port++, current.refresh_time++, current.cycle_sleep++;
+        current.led_outputs++, current.led_backend++, current.symbol_cache++;
+        current.pin_led = static_cast<gpio_num_t>(current.pin_led + 1);
+        current.pin_alarm_switch = static_cast<gpio_num_t>(current.pin_alarm_switch + 1);
+        current.pin_light_switch = static_cast<gpio_num_t>(current.pin_light_switch + 1);
+        current.pin_led_2 = static_cast<gpio_num_t>(current.pin_led_2 + 1);
+        current.pin_led_3 = static_cast<gpio_num_t>(current.pin_led_3 + 1);
+        current.pin_led_4 = static_cast<gpio_num_t>(current.pin_led_4 + 1);
+    });
+    Result one = fields([&] { current.refresh_time++; });
+    Result none = fields([] {});
+
+    ESP_LOGI(TAG, "%-24s %7lld us/save", "blob", static_cast<long long>(blob.us));
+    ESP_LOGI(TAG, "%-24s %7lld us/save", "fields, all changed", static_cast<long long>(all.us));
+    ESP_LOGI(TAG, "%-24s %7lld us/save", "fields, one changed", static_cast<long long>(one.us));
+    ESP_LOGI(TAG, "%-24s %7lld us/save", "fields, none changed", static_cast<long long>(none.us));
+
+    nvs_erase_all(nvs_handle);
+    nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+}
+
+// Settings reads: the mutex the settings used to take against the snapshot load. The
+// snapshot itself is stress tested on the host, see tools/snapshot_stress.cpp.
+static void snapshots() {
+    constexpr int kLoads = 1000;
+    Snapshot<SunriseSettings> snapshot;
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    SunriseSettings guarded;
+    volatile int sink = 0;
+    report("settings, mutex", measure([&](int) {
+        for (int i = 0; i < kLoads; i++) {
+            xSemaphoreTake(mutex, pdMS_TO_TICKS(10));
+            SunriseSettings copy = guarded;
+            xSemaphoreGive(mutex);
+            sink = sink + copy.red;
+        }
+    }), kLoads);
+    report("settings, snapshot", measure([&](int) {
+        for (int i = 0; i < kLoads; i++)
+            sink = sink + snapshot.load().red;
+    }), kLoads);
+    vSemaphoreDelete(mutex);
+}
+
+void run(const LowLevelSettings &settings) {
+    led_writes(settings);
+    color_pipeline(settings);
+    spatial_kernel(settings);
+    fixed_point();
+    settings_storage(settings);
+    snapshots();
+
+    // The checks expect Central European rules, whatever zone is configured
+    Alarm::apply_timezone();
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+    timezone();
+    schedule();
+    setenv("TZ", Settings::get().getTimezone().c_str(), 1);
+    tzset();
+
+    backends(settings);
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include "freertos/FreeRTOS.h"
+
+// Boot runs as concurrent stages: the lamp (settings, strip, switches, first frame) comes
+// up first, network, web server and time follow in the background. Each stage is an
+// event group bit plus the esp_timer time it completed at.
+enum BootStage : uint8_t {
+    BOOT_SETTINGS,
+    BOOT_STRIP,
+    BOOT_SWITCHES,
+    BOOT_FIRST_LIGHT,
+    BOOT_HTTP,
+    BOOT_NETWORK,
+    BOOT_TIME,
+    BOOT_STAGE_COUNT,
+};
+
+namespace Boot {
+    // Idempotent, only the first completion is timed and logged
+    void done(BootStage stage);
+    bool is_done(BootStage stage);
+    bool wait(BootStage stage, TickType_t timeout = portMAX_DELAY);
+    // Microseconds since start, 0 while the stage is pending
+    int64_t time_us(BootStage stage);
+    void log_timings();
+}
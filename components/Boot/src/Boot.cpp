@@ -0,0 +1,63 @@
+#include "Boot.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
+#include <atomic>
+
+static const char *TAG = "Boot";
+
+static const char *const STAGE_NAMES[BOOT_STAGE_COUNT] = {"settings", "strip", "switches", "first light",
+                                                          "http", "network", "time"};
+
+namespace Boot {
+
+static std::atomic<int64_t> s_done_us[BOOT_STAGE_COUNT];
+static std::atomic<int> s_stages_done{0};
+
+static EventGroupHandle_t events()
+{
+    static EventGroupHandle_t group = xEventGroupCreate();
+    return group;
+}
+
+void done(BootStage stage)
+{
+    int64_t expected = 0;
+    int64_t now = esp_timer_get_time();
+    if (!s_done_us[stage].compare_exchange_strong(expected, now))
+        return;
+
+    ESP_LOGI(TAG, "%-11s ready after %5lld ms", STAGE_NAMES[stage], static_cast<long long>(now / 1000));
+    xEventGroupSetBits(events(), 1u << stage);
+    if (s_stages_done.fetch_add(1) + 1 == BOOT_STAGE_COUNT)
+        log_timings();
+}
+
+bool is_done(BootStage stage)
+{
+    return s_done_us[stage].load() != 0;
+}
+
+bool wait(BootStage stage, TickType_t timeout)
+{
+    return xEventGroupWaitBits(events(), 1u << stage, pdFALSE, pdTRUE, timeout) & (1u << stage);
+}
+
+int64_t time_us(BootStage stage)
+{
+    return s_done_us[stage].load();
+}
+
+void log_timings()
+{
+    for (int stage = 0; stage < BOOT_STAGE_COUNT; stage++)
+    {
+        int64_t at = s_done_us[stage].load();
+        if (at)
+            ESP_LOGI(TAG, "%-11s %5lld ms", STAGE_NAMES[stage], static_cast<long long>(at / 1000));
+        else
+            ESP_LOGI(TAG, "%-11s pending", STAGE_NAMES[stage]);
+    }
+}
+
+}
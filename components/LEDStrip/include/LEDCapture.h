@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// Capture file written by LEDStrip on the linux target (LED_BACKEND_CAPTURE).
+// Little endian: one header, then one fixed-size record per frame sent:
+//   int64_t timestamp_us, then led_count * 3 bytes R, G, B (after calibration/dithering)
+namespace LEDCapture {
+
+inline constexpr char kMagic[8] = {'L', 'E', 'D', 'C', 'A', 'P', '0', '1'};
+
+struct Header {
+    char magic[8];
+    uint32_t led_count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(Header) == 16, "capture header layout");
+
+inline constexpr const char *kDefaultPath = "ledstrip.cap";
+inline constexpr const char *kPathEnv = "LEDSTRIP_CAPTURE";
+
+}
@@ -1,17 +1,177 @@
 #pragma once
 
-#include "led_strip.h"
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <cstdio>
+#else
+#include "driver/rmt_tx.h"
+#include "driver/spi_master.h"
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+struct Rgb {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+// Linear light, 16 bits per channel (see Perceptual.h for converting perceptual levels)
+struct Rgb16 {
+    uint16_t r;
+    uint16_t g;
+    uint16_t b;
+};
+
+// How the frame is put on the wire. Plain RMT refills a small symbol memory from an
+// interrupt every few dozen LEDs; with DMA the frame is streamed without CPU help,
+// SPI+DMA trades a cheap encode pass in present() for no interrupts at all.
+enum LedBackend : uint8_t {
+    LED_BACKEND_RMT = 0,
+    LED_BACKEND_RMT_DMA = 1,
+    LED_BACKEND_SPI_DMA = 2,
+    LED_BACKEND_CAPTURE = 3, // linux target: frames go to a capture file, see LEDCapture.h
+};
 
 class LEDStrip {
 public:
-    LEDStrip(int gpio_pin, int led_count, bool use_dma = false);
+    static constexpr int kMaxOutputs = 4;
+    static constexpr size_t kMaxSymbolCacheBytes = 64 * 1024;
+
+    LEDStrip(int gpio_pin, int led_count, LedBackend backend = LED_BACKEND_RMT);
+    // One logical strip split into equal consecutive segments, one per pin. Each segment
+    // has its own RMT channel (or SPI host) and all segments are transmitted in parallel,
+    // so a frame takes as long as the longest segment. A backend the chip cannot provide
+    // falls back to plain RMT for that segment. If an output cannot be set up at all
+    // (pin or channels not available) the strip has no outputs, see ok().
+    LEDStrip(std::span<const int> gpio_pins, int led_count, LedBackend backend = LED_BACKEND_RMT);
     ~LEDStrip();
 
     void setPixel(int index, uint8_t r, uint8_t g, uint8_t b);
-    void refresh();
+
+    // Bulk writes go straight into the wire-order pixel buffer in one pass.
+    void fill(uint8_t r, uint8_t g, uint8_t b);
+    void fillRange(int first, int length, uint8_t r, uint8_t g, uint8_t b);
+    void writeFrame(std::span<const Rgb> frame);
+
+    // High-bit-depth frame. It is kept at 16 bits per channel and reduced to 8 bits with
+    // temporal dithering when the frame is finalized, so ramps below one 8-bit step stay
+    // smooth at the render frame rate. The most recent write mode (8 or 16 bit) wins.
+    void fill(const Rgb16 &color);
+    void fillRange(int first, int length, const Rgb16 &color);
+    void writeFrame(std::span<const Rgb16> frame);
+    // Direct access to the 16-bit frame for kernels that render in place
+    std::span<Rgb16> hdrFrame();
+    void setDithering(bool enabled) { dithering = enabled; }
+
+    // Per-LED colour correction: r, g, b gain triples, 255 = unchanged. A table with fewer
+    // entries than LEDs is stretched over the strip (one entry per segment). Applied when
+    // the frame is finalized, or while copying into the front buffer for 8-bit frames.
+    // An empty table turns calibration off.
+    void setCalibration(std::span<const uint8_t> gains);
+
+    // Converts the 16-bit frame into the back buffer; present() calls this itself.
+    void finalize();
+
+    // Hands the back buffer to the RMT channel and returns without waiting for the
+    // wire. Blocks only while the previous frame is still being sent. Frames equal
+    // to the last one sent are skipped unless force is set (periodic re-sync).
+    // Returns true if a transmission was started.
+    bool present(bool force = false);
+    // Blocks until the last presented frame has left the wire.
+    bool waitDone(TickType_t timeout = portMAX_DELAY);
+    bool busy() const;
+
+    // Keeps the RMT symbols of the last frame in memory. A frame sent again (forced
+    // re-sync) goes out through a copy encoder without being encoded, new frames are
+    // encoded once here instead of in the transmit interrupt. Costs 96 bytes per LED and
+    // is refused above kMaxSymbolCacheBytes. SPI outputs always keep their encoded frame.
+    bool setSymbolCache(bool enabled);
+    size_t symbolCacheBytes() const;
+
+    // present() followed by waitDone()
+    void refresh(bool force = false);
     void clear();
 
+    int size() const { return count; }
+    // False if the outputs could not be created; present() then sends nothing
+    bool ok() const { return !segments.empty(); }
+    int outputs() const { return static_cast<int>(segments.size()); }
+    LedBackend backend() const { return ok() ? segments.front().backend : LED_BACKEND_RMT; }
+    uint32_t framesSent() const { return frames_sent; }
+    uint32_t framesSkipped() const { return frames_skipped; }
+    uint32_t framesReused() const { return frames_reused; }
+
 private:
-    led_strip_handle_t handle;
+#if CONFIG_IDF_TARGET_LINUX
+    struct Segment {
+        LedBackend backend;
+        int first;
+        int length;
+    };
+    FILE *capture = nullptr;
+#else
+    struct Segment {
+        LedBackend backend;
+        rmt_channel_handle_t channel;
+        rmt_encoder_handle_t encoder;
+        spi_host_device_t spi_host;
+        spi_device_handle_t spi;
+        spi_transaction_t spi_trans;
+        uint8_t *spi_buffer;      // DMA capable, SPI encoded frame plus reset time
+        bool spi_queued;
+        rmt_encoder_handle_t copy_encoder;
+        std::vector<rmt_symbol_word_t> symbols; // symbol cache, empty when disabled
+        int first;
+        int length;
+    };
+    rmt_sync_manager_handle_t sync_manager = nullptr;
+#endif
+
+    std::vector<Segment> segments;
+    std::vector<uint8_t> pixels; // back buffer: GRB, 3 bytes per LED, owned by the caller
+    std::vector<uint8_t> front;  // frame currently owned by the RMT channels
+    SemaphoreHandle_t tx_done;   // given when every segment of front has been sent
+    std::atomic<int> tx_pending{0};
     int count;
+
+    uint32_t generation = 0;      // bumped on every buffer write
+    uint32_t sent_generation = 0; // generation of the last transmitted frame
+    uint32_t sent_hash = 0;       // hash of the last transmitted frame
+    bool sent_once = false;
+    uint32_t frames_sent = 0;
+    uint32_t frames_skipped = 0;
+    uint32_t frames_reused = 0;
+    bool encoded_valid = false;   // the encoded buffers hold the frame of sent_hash
+
+    std::vector<Rgb16> hdr;       // 16-bit frame, allocated on first use
+    bool hdr_active = false;
+    bool dithering = true;
+    std::vector<Rgb> gain;        // per-LED calibration, empty when off
+    uint8_t dither_frame = 0;
+
+    uint32_t hashFrame() const;
+    void useHdr();
+    void copyCalibrated(const uint8_t *src, uint8_t *dst) const;
+
+    // Implemented per target: LEDStripOutput.cpp (RMT/SPI) or LEDStripCapture.cpp (linux)
+    esp_err_t initOutputs(std::span<const int> gpio_pins, LedBackend backend);
+    void releaseOutputs();
+    esp_err_t transmit(Segment &segment, bool reuse);
+    void abortTransmit();
+
+#if !CONFIG_IDF_TARGET_LINUX
+    esp_err_t initRmt(Segment &segment, int gpio_pin, bool use_dma);
+    esp_err_t initSpi(Segment &segment, int gpio_pin, spi_host_device_t host);
+    void releaseSpi(Segment &segment);
+
+    bool segmentDone();
+    static bool onTransmitDone(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *event, void *ctx);
+    static void onSpiDone(spi_transaction_t *trans);
+#endif
 };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Perceptual (CIE L*) to linear light conversion for 16-bit channel values.
+// The table is built at compile time; lookups are integer only.
+namespace Perceptual {
+
+inline constexpr int kLutBits = 8;
+inline constexpr int kLutSize = (1 << kLutBits) + 1;
+
+constexpr uint16_t lightness_to_luminance(int index) {
+    double l = static_cast<double>(index) / (kLutSize - 1);
+    double y = l <= 0.08 ? l / 9.033 : ((l + 0.16) / 1.16) * ((l + 0.16) / 1.16) * ((l + 0.16) / 1.16);
+    return static_cast<uint16_t>(y * 65535.0 + 0.5);
+}
+
+constexpr std::array<uint16_t, kLutSize> make_lut() {
+    std::array<uint16_t, kLutSize> lut{};
+    for (int i = 0; i < kLutSize; i++)
+        lut[i] = lightness_to_luminance(i);
+    return lut;
+}
+
+inline constexpr std::array<uint16_t, kLutSize> kLut = make_lut();
+
+static_assert(kLut[0] == 0 && kLut[kLutSize - 1] == 65535, "L* table must span the full range");
+
+// Perceptual level 0..65535 to linear light 0..65535, linearly interpolated between table entries
+constexpr uint16_t to_linear(uint16_t level) {
+    uint32_t index = level >> (16 - kLutBits);
+    uint32_t frac = level & ((1u << (16 - kLutBits)) - 1);
+    uint32_t a = kLut[index];
+    uint32_t b = kLut[index + 1];
+    return static_cast<uint16_t>(a + (((b - a) * frac) >> (16 - kLutBits)));
+}
+
+}
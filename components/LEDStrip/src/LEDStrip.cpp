@@ -1,43 +1,277 @@
 #include "LEDStrip.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
-#define LED_STRIP_RMT_RES_HZ (10 * 1000 * 1000)
+#define LED_STRIP_BYTES_PER_PIXEL 3
 
 static const char *TAG = "LEDStrip";
 
-LEDStrip::LEDStrip(int gpio_pin, int led_count, bool use_dma) : count(led_count) {
-    led_strip_config_t strip_config = {
-        .strip_gpio_num = static_cast<int>(gpio_pin),
-        .max_leds = static_cast<uint32_t>(led_count),
-        .led_model = LED_MODEL_WS2812,
-        .color_component_format = LED_STRIP_COLOR_COMPONENT_FMT_GRB,
-        .flags = { .invert_out = false }
-    };
+LEDStrip::LEDStrip(int gpio_pin, int led_count, LedBackend backend)
+    : LEDStrip(std::span<const int>(&gpio_pin, 1), led_count, backend) {
+}
 
-    led_strip_rmt_config_t rmt_config = {
-        .clk_src = RMT_CLK_SRC_DEFAULT,
-        .resolution_hz = LED_STRIP_RMT_RES_HZ,
-        .mem_block_symbols = static_cast<size_t>(use_dma ? 1024 : 0),
-        .flags = { .with_dma = use_dma }
-    };
+LEDStrip::LEDStrip(std::span<const int> gpio_pins, int led_count, LedBackend backend)
+    : pixels(static_cast<size_t>(led_count) * LED_STRIP_BYTES_PER_PIXEL, 0),
+      front(pixels.size(), 0),
+      tx_done(xSemaphoreCreateBinary()),
+      count(led_count) {
+    assert(tx_done != nullptr);
+    assert(!gpio_pins.empty() && gpio_pins.size() <= kMaxOutputs);
+    xSemaphoreGive(tx_done);
 
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &handle));
-    ESP_LOGI(TAG, "LED strip created");
+    esp_err_t err = initOutputs(gpio_pins, backend);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "LED outputs could not be created (%s)", esp_err_to_name(err));
+        releaseOutputs();
+        segments.clear();
+        return;
+    }
+    ESP_LOGI(TAG, "LED strip created: %d LEDs on %d output(s), backend %d", led_count, outputs(), this->backend());
 }
 
 LEDStrip::~LEDStrip() {
-    led_strip_clear(handle);
+    clear();
+    refresh();
+    releaseOutputs();
+    vSemaphoreDelete(tx_done);
 }
 
 void LEDStrip::setPixel(int index, uint8_t r, uint8_t g, uint8_t b) {
-    ESP_ERROR_CHECK(led_strip_set_pixel(handle, index, r, g, b));
+    if (index < 0 || index >= count) {
+        ESP_LOGE(TAG, "Pixel index %d out of range", index);
+        return;
+    }
+    uint8_t *p = &pixels[index * LED_STRIP_BYTES_PER_PIXEL];
+    hdr_active = false;
+    generation++;
+    p[0] = g;
+    p[1] = r;
+    p[2] = b;
+}
+
+void LEDStrip::fill(uint8_t r, uint8_t g, uint8_t b) {
+    fillRange(0, count, r, g, b);
+}
+
+void LEDStrip::fillRange(int first, int length, uint8_t r, uint8_t g, uint8_t b) {
+    first = std::max(first, 0);
+    length = std::min(length, count - first);
+    if (length <= 0)
+        return;
+
+    hdr_active = false;
+    generation++;
+    uint8_t *dst = &pixels[first * LED_STRIP_BYTES_PER_PIXEL];
+    size_t bytes = static_cast<size_t>(length) * LED_STRIP_BYTES_PER_PIXEL;
+    if (r == g && g == b) {
+        memset(dst, r, bytes);
+        return;
+    }
+
+    // Seed one pixel, then double the initialised region with memcpy
+    dst[0] = g;
+    dst[1] = r;
+    dst[2] = b;
+    size_t done = LED_STRIP_BYTES_PER_PIXEL;
+    while (done < bytes) {
+        size_t chunk = std::min(done, bytes - done);
+        memcpy(dst + done, dst, chunk);
+        done += chunk;
+    }
+}
+
+void LEDStrip::writeFrame(std::span<const Rgb> frame) {
+    size_t n = std::min(frame.size(), static_cast<size_t>(count));
+    hdr_active = false;
+    generation++;
+    uint8_t *dst = pixels.data();
+    for (size_t i = 0; i < n; i++, dst += LED_STRIP_BYTES_PER_PIXEL) {
+        dst[0] = frame[i].g;
+        dst[1] = frame[i].r;
+        dst[2] = frame[i].b;
+    }
+}
+
+void LEDStrip::useHdr() {
+    if (hdr.size() != static_cast<size_t>(count))
+        hdr.assign(count, Rgb16{0, 0, 0});
+    hdr_active = true;
+}
+
+void LEDStrip::fill(const Rgb16 &color) {
+    fillRange(0, count, color);
+}
+
+void LEDStrip::fillRange(int first, int length, const Rgb16 &color) {
+    first = std::max(first, 0);
+    length = std::min(length, count - first);
+    if (length <= 0)
+        return;
+
+    useHdr();
+    std::fill_n(hdr.begin() + first, length, color);
+}
+
+void LEDStrip::writeFrame(std::span<const Rgb16> frame) {
+    size_t n = std::min(frame.size(), static_cast<size_t>(count));
+    useHdr();
+    std::copy_n(frame.begin(), n, hdr.begin());
+}
+
+std::span<Rgb16> LEDStrip::hdrFrame() {
+    useHdr();
+    return std::span<Rgb16>(hdr);
+}
+
+// Bit-reversed 4-bit sequence: every 16 frames each threshold is used once, and
+// consecutive frames (and neighbouring pixels) sit far apart in the cycle.
+static constexpr uint8_t kDither[16] = {8, 136, 72, 200, 40, 168, 104, 232, 24, 152, 88, 216, 56, 184, 120, 248};
+
+static inline uint8_t quantize(uint32_t value, uint8_t threshold) {
+    uint32_t v = (static_cast<uint32_t>(value) + threshold) >> 8;
+    return v > 255 ? 255 : static_cast<uint8_t>(v);
+}
+
+// value * gain / 255 without a division; exact for gain 0 and 255
+static inline uint32_t calibrate(uint32_t value, uint8_t gain) {
+    return (value * (gain * 257u + 1)) >> 16;
+}
+
+void LEDStrip::setCalibration(std::span<const uint8_t> gains) {
+    const size_t entries = gains.size() / 3;
+    if (entries == 0) {
+        gain.clear();
+    } else {
+        gain.resize(count);
+        for (int i = 0; i < count; i++) {
+            const uint8_t *entry = &gains[i * entries / count * 3];
+            gain[i] = {entry[0], entry[1], entry[2]};
+        }
+    }
+    // The content on the wire no longer matches the buffers
+    generation++;
+    sent_once = false;
+}
+
+void LEDStrip::copyCalibrated(const uint8_t *src, uint8_t *dst) const {
+    for (int i = 0; i < count; i++, src += LED_STRIP_BYTES_PER_PIXEL, dst += LED_STRIP_BYTES_PER_PIXEL) {
+        dst[0] = static_cast<uint8_t>(calibrate(src[0], gain[i].g));
+        dst[1] = static_cast<uint8_t>(calibrate(src[1], gain[i].r));
+        dst[2] = static_cast<uint8_t>(calibrate(src[2], gain[i].b));
+    }
+}
+
+void LEDStrip::finalize() {
+    if (!hdr_active)
+        return;
+
+    const uint8_t frame = dither_frame++;
+    const Rgb16 *src = hdr.data();
+    const Rgb *cal = gain.empty() ? nullptr : gain.data();
+    uint8_t *dst = pixels.data();
+    for (int i = 0; i < count; i++, src++, dst += LED_STRIP_BYTES_PER_PIXEL) {
+        uint32_t g = src->g, r = src->r, b = src->b;
+        if (cal) {
+            g = calibrate(g, cal[i].g);
+            r = calibrate(r, cal[i].r);
+            b = calibrate(b, cal[i].b);
+        }
+        // Per-pixel and per-channel phase offsets keep the strip from pulsing in unison
+        uint8_t t_g = dithering ? kDither[(frame + i) & 15] : 128;
+        uint8_t t_r = dithering ? kDither[(frame + i + 5) & 15] : 128;
+        uint8_t t_b = dithering ? kDither[(frame + i + 10) & 15] : 128;
+        dst[0] = quantize(g, t_g);
+        dst[1] = quantize(r, t_r);
+        dst[2] = quantize(b, t_b);
+    }
+    generation++;
+}
+
+uint32_t LEDStrip::hashFrame() const {
+    // FNV-1a, a few cycles per byte and far cheaper than the wire time it can save
+    uint32_t hash = 2166136261u;
+    for (uint8_t byte : pixels)
+        hash = (hash ^ byte) * 16777619u;
+    return hash;
+}
+
+bool LEDStrip::present(bool force) {
+    if (!ok())
+        return false;
+    finalize();
+
+    if (!force && sent_once && generation == sent_generation) {
+        frames_skipped++;
+        return false;
+    }
+
+    // Writes may have produced the same content again, e.g. the idle loop clearing a dark strip
+    uint32_t hash = hashFrame();
+    sent_generation = generation;
+    if (!force && sent_once && hash == sent_hash) {
+        frames_skipped++;
+        return false;
+    }
+
+    xSemaphoreTake(tx_done, portMAX_DELAY);
+    // 16-bit frames were calibrated by finalize(). 8-bit frames are calibrated on the way
+    // into the front buffer, which replaces the swap and copy back below, so the back
+    // buffer keeps the uncalibrated frame for partial updates.
+    const bool copy_calibrated = !hdr_active && !gain.empty();
+    if (copy_calibrated)
+        copyCalibrated(pixels.data(), front.data());
+    else
+        std::swap(pixels, front);
+
+    const bool reuse = encoded_valid && sent_once && hash == sent_hash;
+    esp_err_t err = ESP_OK;
+    tx_pending = static_cast<int>(segments.size());
+    for (size_t i = 0; i < segments.size(); i++) {
+        err = transmit(segments[i], reuse);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Transmit failed on output %u: %s", static_cast<unsigned>(i), esp_err_to_name(err));
+            // Drops what was queued, leaves nothing pending and tx_done given
+            abortTransmit();
+            break;
+        }
+    }
+
+    // Keep the back buffer in sync so partial updates (setPixel, fillRange) build on the
+    // frame just sent. Reading front while the RMT consumes it is fine.
+    if (!copy_calibrated)
+        memcpy(pixels.data(), front.data(), pixels.size());
+
+    sent_hash = hash;
+    sent_once = true;
+    encoded_valid = err == ESP_OK;
+    frames_sent++;
+    if (reuse)
+        frames_reused++;
+    return err == ESP_OK;
+}
+
+
+bool LEDStrip::waitDone(TickType_t timeout) {
+    if (xSemaphoreTake(tx_done, timeout) != pdTRUE)
+        return false;
+    xSemaphoreGive(tx_done);
+    return true;
+}
+
+bool LEDStrip::busy() const {
+    return uxSemaphoreGetCount(tx_done) == 0;
 }
 
-void LEDStrip::refresh() {
-    ESP_ERROR_CHECK(led_strip_refresh(handle));
+void LEDStrip::refresh(bool force) {
+    if (present(force))
+        waitDone();
 }
 
 void LEDStrip::clear() {
-    ESP_ERROR_CHECK(led_strip_clear(handle));
+    hdr_active = false;
+    generation++;
+    std::fill(pixels.begin(), pixels.end(), 0);
 }
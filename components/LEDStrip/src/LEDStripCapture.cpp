@@ -0,0 +1,91 @@
+#include "LEDStrip.h"
+#include "LEDCapture.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+// Simulated output for the linux target: every frame sent is appended to a capture
+// file (see LEDCapture.h) instead of going to RMT or SPI. Transmission completes
+// immediately, so present() never blocks.
+
+#define LED_STRIP_BYTES_PER_PIXEL 3
+
+static const char *TAG = "LEDStrip";
+
+static int64_t now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+esp_err_t LEDStrip::initOutputs(std::span<const int>, LedBackend) {
+    // Segments only matter for the wire, the capture always holds the whole strip
+    segments.push_back({LED_BACKEND_CAPTURE, 0, count});
+
+    const char *path = getenv(LEDCapture::kPathEnv);
+    if (!path)
+        path = LEDCapture::kDefaultPath;
+    capture = fopen(path, "wb");
+    if (!capture) {
+        // The strip still works, frames are just not recorded
+        ESP_LOGE(TAG, "Cannot open capture file %s", path);
+        return ESP_OK;
+    }
+
+    LEDCapture::Header header = {};
+    memcpy(header.magic, LEDCapture::kMagic, sizeof(header.magic));
+    header.led_count = static_cast<uint32_t>(count);
+    fwrite(&header, sizeof(header), 1, capture);
+    ESP_LOGI(TAG, "Capturing frames to %s", path);
+    return ESP_OK;
+}
+
+void LEDStrip::releaseOutputs() {
+    if (capture)
+        fclose(capture);
+    capture = nullptr;
+}
+
+esp_err_t LEDStrip::transmit(Segment &, bool) {
+    if (capture) {
+        int64_t timestamp = now_us();
+        uint8_t rgb[LED_STRIP_BYTES_PER_PIXEL * 64];
+        fwrite(&timestamp, sizeof(timestamp), 1, capture);
+        // front is in wire order (GRB), the capture is RGB
+        for (size_t done = 0; done < front.size();) {
+            size_t chunk = std::min(sizeof(rgb), front.size() - done);
+            for (size_t i = 0; i < chunk; i += LED_STRIP_BYTES_PER_PIXEL) {
+                rgb[i] = front[done + i + 1];
+                rgb[i + 1] = front[done + i];
+                rgb[i + 2] = front[done + i + 2];
+            }
+            fwrite(rgb, 1, chunk, capture);
+            done += chunk;
+        }
+        if (ferror(capture)) {
+            ESP_LOGE(TAG, "Writing the capture failed, capture stopped");
+            releaseOutputs();
+        }
+    }
+
+    // Already "sent", so the frame counts as done even if the capture failed
+    if (tx_pending.fetch_sub(1) == 1)
+        xSemaphoreGive(tx_done);
+    return ESP_OK;
+}
+
+void LEDStrip::abortTransmit() {
+    tx_pending = 0;
+    xSemaphoreTake(tx_done, 0);
+    xSemaphoreGive(tx_done);
+}
+
+bool LEDStrip::setSymbolCache(bool) {
+    return false;
+}
+
+size_t LEDStrip::symbolCacheBytes() const {
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include "LEDStrip.h"
+#include "WS2812Encoder.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "soc/soc_caps.h"
+#include <algorithm>
+
+// RMT and SPI outputs of LEDStrip, see LEDStripCapture.cpp for the host build
+
+#define LED_STRIP_RMT_RES_HZ (10 * 1000 * 1000)
+#define LED_STRIP_BYTES_PER_PIXEL 3
+
+static const char *TAG = "LEDStrip";
+static const ws2812_symbols_t kSymbols = ws2812_symbols(LED_STRIP_RMT_RES_HZ);
+
+#if SOC_SPI_PERIPH_NUM > 2
+static const spi_host_device_t kSpiHosts[] = {SPI2_HOST, SPI3_HOST};
+#else
+static const spi_host_device_t kSpiHosts[] = {SPI2_HOST};
+#endif
+
+esp_err_t LEDStrip::initOutputs(std::span<const int> gpio_pins, LedBackend backend) {
+    const int n = std::max(std::min(static_cast<int>(gpio_pins.size()), count), 1);
+    std::vector<rmt_channel_handle_t> channels;
+    // The SPI transactions point into the segments, they must not move
+    segments.reserve(n);
+
+    for (int i = 0; i < n; i++) {
+        Segment segment = {};
+        segment.first = i * count / n;
+        segment.length = (i + 1) * count / n - segment.first;
+        segments.push_back(segment);
+        Segment &s = segments.back();
+
+        esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+        if (backend == LED_BACKEND_SPI_DMA && i < static_cast<int>(std::size(kSpiHosts)))
+            err = initSpi(s, gpio_pins[i], kSpiHosts[i]);
+        else if (backend == LED_BACKEND_RMT_DMA)
+            err = initRmt(s, gpio_pins[i], true);
+        else if (backend == LED_BACKEND_RMT)
+            err = initRmt(s, gpio_pins[i], false);
+
+        if (err != ESP_OK) {
+            if (backend != LED_BACKEND_RMT)
+                ESP_LOGW(TAG, "Backend %d not available on output %d (%s), using RMT", backend, i, esp_err_to_name(err));
+            err = initRmt(s, gpio_pins[i], false);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "No RMT channel for output %d on GPIO %d (%s)", i, gpio_pins[i], esp_err_to_name(err));
+                return err;
+            }
+        }
+        if (s.backend != LED_BACKEND_SPI_DMA)
+            channels.push_back(s.channel);
+    }
+
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+    // Start all segments on the same clock edge where the hardware can do it, otherwise
+    // they are queued back to back and start within a few microseconds of each other.
+    if (channels.size() > 1) {
+        rmt_sync_manager_config_t sync_config = {};
+        sync_config.tx_channel_array = channels.data();
+        sync_config.array_size = channels.size();
+        esp_err_t err = rmt_new_sync_manager(&sync_config, &sync_manager);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "RMT sync manager failed (%s)", esp_err_to_name(err));
+            return err;
+        }
+    }
+#endif
+    return ESP_OK;
+}
+
+void LEDStrip::releaseOutputs() {
+    if (sync_manager)
+        rmt_del_sync_manager(sync_manager);
+    sync_manager = nullptr;
+    // Also called after a failed initOutputs(), where the last segment has no output
+    for (Segment &segment : segments) {
+        if (segment.backend == LED_BACKEND_SPI_DMA) {
+            releaseSpi(segment);
+            continue;
+        }
+        if (!segment.channel)
+            continue;
+        rmt_disable(segment.channel);
+        rmt_del_channel(segment.channel);
+        rmt_del_encoder(segment.encoder);
+        if (segment.copy_encoder)
+            rmt_del_encoder(segment.copy_encoder);
+    }
+}
+
+void LEDStrip::abortTransmit() {
+    // The segments queued before the failure would wait for the sync forever, or finish
+    // later and count against the next frame. Drop them and start from a clean state.
+    for (Segment &segment : segments) {
+        if (segment.backend == LED_BACKEND_SPI_DMA) {
+            // A queued SPI transaction cannot be cancelled, it ends after one frame time
+            spi_transaction_t *done;
+            TickType_t timeout = pdMS_TO_TICKS(segment.spi_trans.length / (WS2812_SPI_CLOCK_HZ / 1000) + 10);
+            if (segment.spi_queued && spi_device_get_trans_result(segment.spi, &done, timeout) == ESP_OK)
+                segment.spi_queued = false;
+            continue;
+        }
+        // Disabling stops the channel and discards its queue without completion callbacks
+        rmt_disable(segment.channel);
+        rmt_enable(segment.channel);
+    }
+    if (sync_manager)
+        rmt_sync_reset(sync_manager);
+
+    tx_pending = 0;
+    xSemaphoreTake(tx_done, 0);
+    xSemaphoreGive(tx_done);
+}
+
+esp_err_t LEDStrip::initRmt(Segment &segment, int gpio_pin, bool use_dma) {
+    rmt_tx_channel_config_t rmt_config = {};
+    rmt_config.gpio_num = static_cast<gpio_num_t>(gpio_pin);
+    rmt_config.clk_src = RMT_CLK_SRC_DEFAULT;
+    rmt_config.resolution_hz = LED_STRIP_RMT_RES_HZ;
+    rmt_config.mem_block_symbols = use_dma ? 1024 : 64;
+    rmt_config.trans_queue_depth = 4;
+    rmt_config.flags.with_dma = use_dma;
+
+    // Fails on chips (or channels) without RMT DMA, the caller falls back
+    esp_err_t err = rmt_new_tx_channel(&rmt_config, &segment.channel);
+    if (err != ESP_OK)
+        return err;
+    err = new_ws2812_encoder(LED_STRIP_RMT_RES_HZ, &segment.encoder);
+
+    rmt_tx_event_callbacks_t callbacks = {};
+    callbacks.on_trans_done = onTransmitDone;
+    if (err == ESP_OK)
+        err = rmt_tx_register_event_callbacks(segment.channel, &callbacks, this);
+
+    // The channels stay enabled for the lifetime of the strip, frames are only queued
+    if (err == ESP_OK)
+        err = rmt_enable(segment.channel);
+    if (err != ESP_OK) {
+        if (segment.encoder)
+            rmt_del_encoder(segment.encoder);
+        rmt_del_channel(segment.channel);
+        segment.encoder = nullptr;
+        segment.channel = nullptr;
+        return err;
+    }
+    segment.backend = use_dma ? LED_BACKEND_RMT_DMA : LED_BACKEND_RMT;
+    return ESP_OK;
+}
+
+esp_err_t LEDStrip::initSpi(Segment &segment, int gpio_pin, spi_host_device_t host) {
+    size_t bytes = static_cast<size_t>(segment.length) * LED_STRIP_BYTES_PER_PIXEL * WS2812_SPI_BYTES_PER_BYTE +
+                   WS2812_SPI_RESET_BYTES;
+    // Zeroed once, the reset tail is never written again
+    segment.spi_buffer = static_cast<uint8_t *>(heap_caps_calloc(bytes, 1, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+    if (!segment.spi_buffer)
+        return ESP_ERR_NO_MEM;
+
+    spi_bus_config_t bus_config = {};
+    bus_config.mosi_io_num = gpio_pin;
+    bus_config.miso_io_num = -1;
+    bus_config.sclk_io_num = -1;
+    bus_config.quadwp_io_num = -1;
+    bus_config.quadhd_io_num = -1;
+    bus_config.max_transfer_sz = static_cast<int>(bytes);
+    esp_err_t err = spi_bus_initialize(host, &bus_config, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK) {
+        heap_caps_free(segment.spi_buffer);
+        segment.spi_buffer = nullptr;
+        return err;
+    }
+
+    spi_device_interface_config_t dev_config = {};
+    dev_config.clock_speed_hz = WS2812_SPI_CLOCK_HZ;
+    dev_config.mode = 0;
+    dev_config.spics_io_num = -1;
+    dev_config.queue_size = 1;
+    dev_config.post_cb = onSpiDone;
+    err = spi_bus_add_device(host, &dev_config, &segment.spi);
+    if (err != ESP_OK) {
+        spi_bus_free(host);
+        heap_caps_free(segment.spi_buffer);
+        segment.spi_buffer = nullptr;
+        return err;
+    }
+
+    segment.backend = LED_BACKEND_SPI_DMA;
+    segment.spi_host = host;
+    segment.spi_trans = {};
+    segment.spi_trans.length = bytes * 8;
+    segment.spi_trans.tx_buffer = segment.spi_buffer;
+    segment.spi_trans.user = this;
+    return ESP_OK;
+}
+
+void LEDStrip::releaseSpi(Segment &segment) {
+    spi_transaction_t *done;
+    if (segment.spi_queued)
+        spi_device_get_trans_result(segment.spi, &done, portMAX_DELAY);
+    spi_bus_remove_device(segment.spi);
+    spi_bus_free(segment.spi_host);
+    heap_caps_free(segment.spi_buffer);
+}
+
+bool IRAM_ATTR LEDStrip::segmentDone() {
+    if (tx_pending.fetch_sub(1) != 1)
+        return false;
+
+    BaseType_t high_task_wakeup = pdFALSE;
+    xSemaphoreGiveFromISR(tx_done, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+bool IRAM_ATTR LEDStrip::onTransmitDone(rmt_channel_handle_t, const rmt_tx_done_event_data_t *, void *ctx) {
+    return static_cast<LEDStrip *>(ctx)->segmentDone();
+}
+
+void IRAM_ATTR LEDStrip::onSpiDone(spi_transaction_t *trans) {
+    if (static_cast<LEDStrip *>(trans->user)->segmentDone())
+        portYIELD_FROM_ISR();
+}
+
+esp_err_t LEDStrip::transmit(Segment &segment, bool reuse) {
+    const uint8_t *data = front.data() + segment.first * LED_STRIP_BYTES_PER_PIXEL;
+    size_t size = static_cast<size_t>(segment.length) * LED_STRIP_BYTES_PER_PIXEL;
+
+    if (segment.backend == LED_BACKEND_SPI_DMA) {
+        // The previous transaction has completed (tx_done was taken), collect it
+        spi_transaction_t *done;
+        if (segment.spi_queued)
+            spi_device_get_trans_result(segment.spi, &done, 0);
+        if (!reuse)
+            ws2812_spi_encode(data, size, segment.spi_buffer);
+        esp_err_t err = spi_device_queue_trans(segment.spi, &segment.spi_trans, 0);
+        segment.spi_queued = err == ESP_OK;
+        return err;
+    }
+
+    rmt_transmit_config_t tx_config = {};
+    if (!segment.symbols.empty()) {
+        if (!reuse)
+            ws2812_encode_symbols(data, size, kSymbols, segment.symbols.data());
+        return rmt_transmit(segment.channel, segment.copy_encoder, segment.symbols.data(),
+                            segment.symbols.size() * sizeof(rmt_symbol_word_t), &tx_config);
+    }
+    return rmt_transmit(segment.channel, segment.encoder, data, size, &tx_config);
+}
+
+bool LEDStrip::setSymbolCache(bool enabled) {
+    // The cached symbols may be on the wire right now
+    waitDone();
+
+    size_t bytes = pixels.size() * WS2812_SYMBOLS_PER_BYTE * sizeof(rmt_symbol_word_t);
+    if (enabled && bytes > kMaxSymbolCacheBytes) {
+        ESP_LOGW(TAG, "Symbol cache for %d LEDs would need %u bytes, limit is %u", count,
+                 static_cast<unsigned>(bytes), static_cast<unsigned>(kMaxSymbolCacheBytes));
+        enabled = false;
+    }
+
+    esp_err_t err = ESP_OK;
+    for (Segment &segment : segments) {
+        if (segment.backend == LED_BACKEND_SPI_DMA)
+            continue;
+        if (!enabled) {
+            std::vector<rmt_symbol_word_t>().swap(segment.symbols);
+            continue;
+        }
+        if (!segment.copy_encoder) {
+            rmt_copy_encoder_config_t copy_config = {};
+            err = rmt_new_copy_encoder(&copy_config, &segment.copy_encoder);
+            if (err != ESP_OK) {
+                segment.copy_encoder = nullptr;
+                break;
+            }
+        }
+        segment.symbols.resize(static_cast<size_t>(segment.length) * LED_STRIP_BYTES_PER_PIXEL * WS2812_SYMBOLS_PER_BYTE + 1);
+    }
+
+    // Only an optimisation: without the copy encoder frames keep the normal encoder
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Symbol cache not available (%s)", esp_err_to_name(err));
+        for (Segment &segment : segments)
+            std::vector<rmt_symbol_word_t>().swap(segment.symbols);
+        enabled = false;
+    }
+
+    encoded_valid = false;
+    if (enabled)
+        ESP_LOGI(TAG, "Symbol cache enabled, %u bytes", static_cast<unsigned>(symbolCacheBytes()));
+    return enabled;
+}
+
+size_t LEDStrip::symbolCacheBytes() const {
+    size_t bytes = 0;
+    for (const Segment &segment : segments)
+        bytes += segment.symbols.capacity() * sizeof(rmt_symbol_word_t);
+    return bytes;
+}
+
@@ -0,0 +1,166 @@
+#include "WS2812Encoder.h"
+#include "esp_check.h"
+#include <array>
+#include <cstdlib>
+
+static const char *TAG = "WS2812Encoder";
+
+namespace {
+
+struct ws2812_encoder_t {
+    rmt_encoder_t base;
+    rmt_encoder_handle_t bytes_encoder;
+    rmt_encoder_handle_t copy_encoder;
+    int state;
+    rmt_symbol_word_t reset_code;
+};
+
+size_t encode(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *data, size_t data_size, rmt_encode_state_t *ret_state)
+{
+    auto *ws = __containerof(encoder, ws2812_encoder_t, base);
+    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
+    int state = RMT_ENCODING_RESET;
+    size_t encoded_symbols = 0;
+
+    if (ws->state == 0) {
+        encoded_symbols += ws->bytes_encoder->encode(ws->bytes_encoder, channel, data, data_size, &session_state);
+        if (session_state & RMT_ENCODING_COMPLETE)
+            ws->state = 1;
+        if (session_state & RMT_ENCODING_MEM_FULL) {
+            *ret_state = static_cast<rmt_encode_state_t>(state | RMT_ENCODING_MEM_FULL);
+            return encoded_symbols;
+        }
+    }
+
+    encoded_symbols += ws->copy_encoder->encode(ws->copy_encoder, channel, &ws->reset_code, sizeof(ws->reset_code), &session_state);
+    if (session_state & RMT_ENCODING_COMPLETE) {
+        ws->state = 0;
+        state |= RMT_ENCODING_COMPLETE;
+    }
+    if (session_state & RMT_ENCODING_MEM_FULL)
+        state |= RMT_ENCODING_MEM_FULL;
+
+    *ret_state = static_cast<rmt_encode_state_t>(state);
+    return encoded_symbols;
+}
+
+esp_err_t reset(rmt_encoder_t *encoder)
+{
+    auto *ws = __containerof(encoder, ws2812_encoder_t, base);
+    rmt_encoder_reset(ws->bytes_encoder);
+    rmt_encoder_reset(ws->copy_encoder);
+    ws->state = 0;
+    return ESP_OK;
+}
+
+esp_err_t del(rmt_encoder_t *encoder)
+{
+    auto *ws = __containerof(encoder, ws2812_encoder_t, base);
+    if (ws->bytes_encoder)
+        rmt_del_encoder(ws->bytes_encoder);
+    if (ws->copy_encoder)
+        rmt_del_encoder(ws->copy_encoder);
+    free(ws);
+    return ESP_OK;
+}
+
+}
+
+ws2812_symbols_t ws2812_symbols(uint32_t resolution_hz)
+{
+    const uint32_t ticks_per_us = resolution_hz / 1000000;
+    ws2812_symbols_t symbols = {};
+
+    // WS2812 timing: T0H=0.3us T0L=0.9us, T1H=0.9us T1L=0.3us, MSB first
+    symbols.bit0.level0 = 1;
+    symbols.bit0.duration0 = ticks_per_us * 3 / 10;
+    symbols.bit0.level1 = 0;
+    symbols.bit0.duration1 = ticks_per_us * 9 / 10;
+    symbols.bit1.level0 = 1;
+    symbols.bit1.duration0 = ticks_per_us * 9 / 10;
+    symbols.bit1.level1 = 0;
+    symbols.bit1.duration1 = ticks_per_us * 3 / 10;
+
+    // 280us low latches the frame (WS2812B-V5 needs more than the 50us of the datasheet)
+    const uint32_t reset_ticks = ticks_per_us * 280 / 2;
+    symbols.reset.level0 = 0;
+    symbols.reset.duration0 = reset_ticks;
+    symbols.reset.level1 = 0;
+    symbols.reset.duration1 = reset_ticks;
+    return symbols;
+}
+
+void ws2812_encode_symbols(const uint8_t *data, size_t data_size, const ws2812_symbols_t &symbols, rmt_symbol_word_t *out)
+{
+    for (size_t i = 0; i < data_size; i++) {
+        uint8_t byte = data[i];
+        for (int bit = 0; bit < 8; bit++, byte <<= 1)
+            *out++ = byte & 0x80 ? symbols.bit1 : symbols.bit0;
+    }
+    *out = symbols.reset;
+}
+
+esp_err_t new_ws2812_encoder(uint32_t resolution_hz, rmt_encoder_handle_t *ret_encoder)
+{
+    ESP_RETURN_ON_FALSE(ret_encoder, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    auto *ws = static_cast<ws2812_encoder_t *>(calloc(1, sizeof(ws2812_encoder_t)));
+    ESP_RETURN_ON_FALSE(ws, ESP_ERR_NO_MEM, TAG, "no mem for encoder");
+    ws->base.encode = encode;
+    ws->base.reset = reset;
+    ws->base.del = del;
+
+    const ws2812_symbols_t symbols = ws2812_symbols(resolution_hz);
+    rmt_bytes_encoder_config_t bytes_config = {};
+    bytes_config.bit0 = symbols.bit0;
+    bytes_config.bit1 = symbols.bit1;
+    bytes_config.flags.msb_first = 1;
+
+    rmt_copy_encoder_config_t copy_config = {};
+
+    esp_err_t err = rmt_new_bytes_encoder(&bytes_config, &ws->bytes_encoder);
+    if (err == ESP_OK)
+        err = rmt_new_copy_encoder(&copy_config, &ws->copy_encoder);
+    if (err != ESP_OK) {
+        del(&ws->base);
+        ESP_LOGE(TAG, "creating sub encoders failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ws->reset_code = symbols.reset;
+
+    *ret_encoder = &ws->base;
+    return ESP_OK;
+}
+
+namespace {
+
+constexpr uint32_t spi_pattern(uint8_t byte)
+{
+    uint32_t bits = 0;
+    for (int i = 7; i >= 0; i--)
+        bits = (bits << 3) | ((byte >> i) & 1 ? 0b110 : 0b100);
+    return bits;
+}
+
+constexpr std::array<uint32_t, 256> make_spi_table()
+{
+    std::array<uint32_t, 256> table{};
+    for (int i = 0; i < 256; i++)
+        table[i] = spi_pattern(static_cast<uint8_t>(i));
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> kSpiTable = make_spi_table();
+
+}
+
+void ws2812_spi_encode(const uint8_t *data, size_t data_size, uint8_t *out)
+{
+    for (size_t i = 0; i < data_size; i++) {
+        uint32_t bits = kSpiTable[data[i]];
+        *out++ = static_cast<uint8_t>(bits >> 16);
+        *out++ = static_cast<uint8_t>(bits >> 8);
+        *out++ = static_cast<uint8_t>(bits);
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "driver/rmt_encoder.h"
+
+struct ws2812_symbols_t {
+    rmt_symbol_word_t bit0;
+    rmt_symbol_word_t bit1;
+    rmt_symbol_word_t reset;
+};
+
+ws2812_symbols_t ws2812_symbols(uint32_t resolution_hz);
+
+// Encodes a GRB byte stream into WS2812 symbols followed by the latch/reset code.
+esp_err_t new_ws2812_encoder(uint32_t resolution_hz, rmt_encoder_handle_t *ret_encoder);
+
+// Same stream written out in full, 8 symbols per byte plus the reset symbol, for
+// sending from memory with a copy encoder.
+#define WS2812_SYMBOLS_PER_BYTE 8
+void ws2812_encode_symbols(const uint8_t *data, size_t data_size, const ws2812_symbols_t &symbols, rmt_symbol_word_t *out);
+
+// SPI variant: every data bit becomes three SPI bits (1 -> 110, 0 -> 100) at 2.5 MHz,
+// so one GRB byte takes three bytes on the wire.
+#define WS2812_SPI_CLOCK_HZ (2500 * 1000)
+#define WS2812_SPI_BYTES_PER_BYTE 3
+// Low time appended after each frame, > 280 us at 3.2 us per byte
+#define WS2812_SPI_RESET_BYTES 90
+
+void ws2812_spi_encode(const uint8_t *data, size_t data_size, uint8_t *out);
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include "esp_err.h"
+
+// Dynamic frequency scaling and automatic light sleep (CONFIG_PM_ENABLE with tickless
+// idle). Whatever needs the chip awake holds an esp_pm lock: the render task while the
+// sunrise animates, the LED drivers while a frame is on the wire, the WiFi driver
+// around beacons. esp_timer deadlines and the GPIO wakeup of the switches end a sleep.
+namespace Power {
+    struct SleepStats {
+        uint64_t asleep_us;
+        uint64_t awake_us;
+        uint32_t sleeps;
+    };
+
+    // ESP_ERR_NOT_SUPPORTED when power management is not compiled in
+    esp_err_t init(int min_freq_mhz, bool light_sleep);
+    bool light_sleep_enabled();
+    SleepStats sleep_stats();
+}
@@ -0,0 +1,77 @@
+#include "Power.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "Power";
+
+namespace Power {
+
+static bool s_light_sleep = false;
+static uint64_t s_asleep_us = 0;
+static uint32_t s_sleeps = 0;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// Runs from the idle task with interrupts off, right after waking up
+static esp_err_t IRAM_ATTR on_wakeup(int64_t slept_us, void *)
+{
+    portENTER_CRITICAL_SAFE(&s_stats_lock);
+    s_asleep_us += slept_us;
+    s_sleeps++;
+    portEXIT_CRITICAL_SAFE(&s_stats_lock);
+    return ESP_OK;
+}
+#endif
+
+esp_err_t init(int min_freq_mhz, bool light_sleep)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t config = {};
+    config.max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    config.min_freq_mhz = min_freq_mhz;
+    config.light_sleep_enable = light_sleep;
+    esp_err_t err = esp_pm_configure(&config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t callbacks = {};
+    callbacks.exit_cb = on_wakeup;
+    esp_pm_light_sleep_register_cbs(&callbacks);
+#endif
+
+    s_light_sleep = light_sleep;
+    ESP_LOGI(TAG, "CPU %d..%d MHz, light sleep %s", min_freq_mhz, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+             light_sleep ? "on" : "off");
+    return ESP_OK;
+#else
+    (void)min_freq_mhz;
+    (void)light_sleep;
+    ESP_LOGW(TAG, "Power management disabled (CONFIG_PM_ENABLE)");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+bool light_sleep_enabled()
+{
+    return s_light_sleep;
+}
+
+SleepStats sleep_stats()
+{
+    taskENTER_CRITICAL(&s_stats_lock);
+    SleepStats stats = {s_asleep_us, 0, s_sleeps};
+    taskEXIT_CRITICAL(&s_stats_lock);
+    uint64_t uptime_us = esp_timer_get_time();
+    stats.awake_us = uptime_us > stats.asleep_us ? uptime_us - stats.asleep_us : 0;
+    return stats;
+}
+
+}
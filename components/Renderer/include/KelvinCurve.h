@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "LEDStrip.h"
+
+// Sunrise colour following the black body locus from start_kelvin to end_kelvin while the
+// brightness ramps up perceptually. Built once per settings change into a small fixed-point
+// table; at() is a lookup plus an integer interpolation.
+class KelvinCurve {
+public:
+    static constexpr int kSteps = 64;
+
+    void build(int start_kelvin, int end_kelvin);
+    bool matches(int start_kelvin, int end_kelvin) const
+    {
+        return built_ && start_kelvin == start_kelvin_ && end_kelvin == end_kelvin_;
+    }
+
+    // progress 0..65535 over the ramp
+    Rgb16 at(uint16_t progress) const;
+
+private:
+    std::array<Rgb16, kSteps + 1> table_{};
+    int start_kelvin_ = 0;
+    int end_kelvin_ = 0;
+    bool built_ = false;
+};
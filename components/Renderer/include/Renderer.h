@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "LEDStrip.h"
+#include "WebServer.h"
+#include "Settings.h"
+#include "Alarm.h"
+#include "KelvinCurve.h"
+#include "Timeline.h"
+
+struct RenderStats {
+    uint32_t frames = 0;
+    uint32_t frame_time_us = 0;     // render + present of the last frame
+    uint32_t max_frame_time_us = 0;
+    uint32_t jitter_us = 0;         // |actual - nominal| period of the last frame
+    uint32_t max_jitter_us = 0;
+    uint32_t input_latency_us = 0;  // switch edge until its frame was presented
+    uint32_t max_input_latency_us = 0;
+    uint32_t frames_sent = 0;       // LEDStrip counters, summed over rebuilt strips
+    uint32_t frames_skipped = 0;
+    uint32_t frames_reused = 0;
+    uint32_t strip_rebuilds = 0;
+};
+
+// Renders the sunrise into the LED strip from its own task. While the sunrise ramps
+// or holds, frames are paced by an esp_timer at LowLevelSettings::refresh_time; a
+// static picture (off, preview) is rendered once and the task then sleeps until the
+// next sunrise transition or wake().
+//
+// Low-level settings changes apply between two frames: the strip is rebuilt when its
+// LED count, pins, outputs or backend change, refresh_time and the sunrise colour take
+// effect on the next frame.
+class Renderer {
+public:
+    Renderer(std::unique_ptr<LEDStrip> strip, const WebServer &server, const LowLevelSettings &settings);
+    ~Renderer();
+
+    esp_err_t start(BaseType_t core = tskNO_AFFINITY, UBaseType_t priority = 10, uint32_t stack_size = 4096);
+    void stop();
+    // Re-render now, e.g. after the settings changed. input_us is the esp_timer time
+    // of the input that caused it, for the input latency in stats().
+    void wake(int64_t input_us = 0);
+    TaskHandle_t task() const { return task_; }
+    // Blocks until the first frame has been presented after start()
+    bool wait_first_frame(TickType_t timeout);
+
+    RenderStats stats() const;
+    void reset_stats();
+
+    // The strip is not ok() if the driver refused the pins or ran out of channels
+    static std::unique_ptr<LEDStrip> create_strip(const LowLevelSettings &settings);
+    // Copies the fields create_strip() uses
+    static void copy_strip_layout(LowLevelSettings &to, const LowLevelSettings &from);
+
+private:
+    std::unique_ptr<LEDStrip> strip_; // owned by the render task once started
+    const WebServer &server_;
+    LowLevelSettings settings_;
+    uint32_t settings_revision_;
+    RenderStats retired_;             // frame counters of strips already replaced
+
+    TaskHandle_t task_;
+    esp_timer_handle_t timer_;          // frame timer, runs only while animating
+    esp_timer_handle_t deadline_timer_; // one-shot to the next transition when static
+    bool animating_;
+    esp_pm_lock_handle_t pm_lock_;      // full CPU clock while animating, nullptr without PM
+
+    std::atomic<int64_t> input_us_;
+    SemaphoreHandle_t first_frame_;
+    RenderStats stats_;
+    mutable portMUX_TYPE stats_lock_;
+
+    // Alarms by next occurrence; the head is the current or next sunrise. Rebuilt when
+    // the alarms change, otherwise only advanced when the head is over.
+    Alarm::Schedule schedule_;
+    Alarm::SunrisePlan plan_;
+    AlarmEntry plan_alarm_;
+    bool plan_valid_;
+    bool schedule_built_ = false;
+    SunriseSettings plan_settings_;
+    uint32_t alarms_revision_ = 0;
+    uint32_t timezone_revision_ = 0;
+    int64_t epoch_offset_ms_; // epoch ms = esp_timer ms + offset
+
+    int64_t last_resync_us_;
+
+    KelvinCurve kelvin_curve_;
+    Timeline timeline_;
+    uint32_t timeline_revision_ = 0;
+    bool timeline_compiled_ = false;
+    uint32_t calibration_revision_ = 0;
+    bool calibration_applied_ = false;
+
+    static void task_entry(void *arg);
+    static void on_tick(void *arg);
+    void run();
+    void apply_settings();
+    bool render_frame(int64_t now_us, int64_t &deadline_us);
+    void schedule(bool animating, int64_t deadline_us);
+    Rgb16 sunrise_color(const SunriseSettings &sunrise, uint16_t progress);
+    int64_t update_plan(const SunriseSettings &sunrise, int64_t now_us);
+};
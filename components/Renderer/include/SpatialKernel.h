@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include "LEDStrip.h"
+#include "Settings.h"
+
+// Per-LED sunrise: a glowing sun travels along the strip over a sky gradient that
+// fades towards the horizon. Integer only, one pass over the frame buffer.
+namespace SpatialKernel {
+    // progress 0..65535 over the ramp, color is the sunrise colour at that progress.
+    // fill 0..65535 raises the sky behind the sun to full brightness, for the hold after
+    // the ramp; at 0 the strip away from the sun stays at sky level.
+    void render(std::span<Rgb16> frame, SpatialMode mode, uint16_t progress, const Rgb16 &color, uint16_t fill = 0);
+}
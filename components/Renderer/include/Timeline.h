@@ -0,0 +1,22 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "LEDStrip.h"
+#include "Settings.h"
+
+// Keyframe timeline compiled into a dense table. Colours are interpolated in OKLab and
+// brightness perceptually when compiling, so the render path never converts colour spaces.
+class Timeline {
+public:
+    static constexpr int kSteps = 256;
+
+    void compile(const std::vector<Keyframe> &keyframes);
+
+    // progress 0..65535 over the ramp
+    Rgb16 at(uint16_t progress) const;
+
+private:
+    std::array<Rgb16, kSteps + 1> table_{};
+};
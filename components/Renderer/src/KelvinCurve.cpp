@@ -0,0 +1,74 @@
+#include "KelvinCurve.h"
+#include "Perceptual.h"
+#include <algorithm>
+#include <cmath>
+
+// Black body colour as 8-bit sRGB, after Tanner Helland's fit of the CIE 1964 data
+static void kelvin_to_srgb(float kelvin, float &r, float &g, float &b)
+{
+    float t = kelvin / 100.0f;
+    if (t <= 66.0f)
+    {
+        r = 255.0f;
+        g = 99.4708025861f * logf(t) - 161.1195681661f;
+    }
+    else
+    {
+        r = 329.698727446f * powf(t - 60.0f, -0.1332047592f);
+        g = 288.1221695283f * powf(t - 60.0f, -0.0755148492f);
+    }
+
+    if (t >= 66.0f)
+        b = 255.0f;
+    else if (t <= 19.0f)
+        b = 0.0f;
+    else
+        b = 138.5177312231f * logf(t - 10.0f) - 305.0447927307f;
+
+    r = std::clamp(r, 0.0f, 255.0f);
+    g = std::clamp(g, 0.0f, 255.0f);
+    b = std::clamp(b, 0.0f, 255.0f);
+}
+
+static uint16_t srgb_to_linear16(float c, uint32_t brightness)
+{
+    float linear = powf(c / 255.0f, 2.2f);
+    return static_cast<uint16_t>(linear * brightness + 0.5f);
+}
+
+void KelvinCurve::build(int start_kelvin, int end_kelvin)
+{
+    // Interpolate in mired (1e6 / K); equal steps there look like equal colour steps
+    const float start_mired = 1e6f / std::max(start_kelvin, 500);
+    const float end_mired = 1e6f / std::max(end_kelvin, 500);
+
+    for (int i = 0; i <= kSteps; i++)
+    {
+        float f = static_cast<float>(i) / kSteps;
+        float kelvin = 1e6f / (start_mired + (end_mired - start_mired) * f);
+        uint32_t brightness = Perceptual::to_linear(static_cast<uint16_t>(i * 65535 / kSteps));
+
+        float r, g, b;
+        kelvin_to_srgb(kelvin, r, g, b);
+        table_[i] = Rgb16{srgb_to_linear16(r, brightness), srgb_to_linear16(g, brightness), srgb_to_linear16(b, brightness)};
+    }
+
+    start_kelvin_ = start_kelvin;
+    end_kelvin_ = end_kelvin;
+    built_ = true;
+}
+
+Rgb16 KelvinCurve::at(uint16_t progress) const
+{
+    // Top 6 bits select the segment, the low 10 bits interpolate
+    static_assert(kSteps == 64, "index split assumes 64 steps");
+    uint32_t index = progress >> 10;
+    uint32_t frac = progress & 0x3FF;
+
+    const Rgb16 &a = table_[index];
+    const Rgb16 &b = table_[index + 1];
+    auto lerp = [frac](uint16_t x, uint16_t y) {
+        return static_cast<uint16_t>(x + ((static_cast<int32_t>(y) - x) * static_cast<int32_t>(frac) >> 10));
+    };
+    return Rgb16{lerp(a.r, b.r), lerp(a.g, b.g), lerp(a.b, b.b)};
+}
@@ -0,0 +1,442 @@
+#include "Renderer.h"
+#include "Alarm.h"
+#include "Perceptual.h"
+#include "SpatialKernel.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <sys/time.h>
+
+static const char *TAG = "Renderer";
+
+// Unchanged frames are not sent; re-send one anyway this often to recover from glitches
+#define LED_RESYNC_INTERVAL_US (60LL * 1000 * 1000)
+// A wall clock step larger than this (SNTP sync, manual set) re-plans the sunrise
+#define CLOCK_STEP_MS 1000
+// 2023-01-01, anything earlier is the unset clock after boot
+#define CLOCK_VALID_AFTER_S 1672531200
+// Spatial modes: after the ramp the rest of the strip catches up with the sun this fast
+#define SKY_FILL_MS (60LL * 1000)
+
+Renderer::Renderer(std::unique_ptr<LEDStrip> strip, const WebServer &server, const LowLevelSettings &settings)
+    : strip_(std::move(strip)), server_(server), settings_(settings),
+      settings_revision_(Settings::get().lowLevelRevision()), retired_(), task_(nullptr), timer_(nullptr), deadline_timer_(nullptr),
+      animating_(false), pm_lock_(nullptr), input_us_(0), first_frame_(xSemaphoreCreateBinary()), stats_(), stats_lock_(portMUX_INITIALIZER_UNLOCKED),
+      plan_(), plan_alarm_(), plan_valid_(false), plan_settings_(), epoch_offset_ms_(0), last_resync_us_(0)
+{
+}
+
+Renderer::~Renderer()
+{
+    stop();
+    vSemaphoreDelete(first_frame_);
+}
+
+std::unique_ptr<LEDStrip> Renderer::create_strip(const LowLevelSettings &settings)
+{
+    const int pins[LEDStrip::kMaxOutputs] = {settings.pin_led, settings.pin_led_2, settings.pin_led_3, settings.pin_led_4};
+    size_t outputs = std::clamp<size_t>(settings.led_outputs, 1, LEDStrip::kMaxOutputs);
+    auto strip = std::make_unique<LEDStrip>(std::span<const int>(pins, outputs), settings.num_leds,
+                                            static_cast<LedBackend>(settings.led_backend));
+    if (settings.symbol_cache)
+        strip->setSymbolCache(true);
+    return strip;
+}
+
+static bool same_strip_layout(const LowLevelSettings &a, const LowLevelSettings &b)
+{
+    if (a.num_leds != b.num_leds || a.led_outputs != b.led_outputs || a.led_backend != b.led_backend ||
+        a.pin_led != b.pin_led)
+        return false;
+    const gpio_num_t pins_a[] = {a.pin_led_2, a.pin_led_3, a.pin_led_4};
+    const gpio_num_t pins_b[] = {b.pin_led_2, b.pin_led_3, b.pin_led_4};
+    // Pins past led_outputs are unused
+    for (int i = 0; i + 1 < std::min<int>(a.led_outputs, LEDStrip::kMaxOutputs); i++)
+        if (pins_a[i] != pins_b[i])
+            return false;
+    return true;
+}
+
+void Renderer::copy_strip_layout(LowLevelSettings &to, const LowLevelSettings &from)
+{
+    to.num_leds = from.num_leds;
+    to.led_outputs = from.led_outputs;
+    to.led_backend = from.led_backend;
+    to.pin_led = from.pin_led;
+    to.pin_led_2 = from.pin_led_2;
+    to.pin_led_3 = from.pin_led_3;
+    to.pin_led_4 = from.pin_led_4;
+}
+
+esp_err_t Renderer::start(BaseType_t core, UBaseType_t priority, uint32_t stack_size)
+{
+    if (xTaskCreatePinnedToCore(task_entry, "render", stack_size, this, priority, &task_, core) != pdPASS)
+        return ESP_FAIL;
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = on_tick;
+    timer_args.arg = this;
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    // Straight from the interrupt, the esp_timer task shares core 0 with the network
+    timer_args.dispatch_method = ESP_TIMER_ISR;
+#else
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+#endif
+    timer_args.name = "render_tick";
+    timer_args.skip_unhandled_events = true;
+    esp_err_t err = esp_timer_create(&timer_args, &timer_);
+    if (err == ESP_OK)
+    {
+        timer_args.name = "render_deadline";
+        err = esp_timer_create(&timer_args, &deadline_timer_);
+    }
+    if (err != ESP_OK)
+        return err;
+#if CONFIG_PM_ENABLE
+    // The frame timer alone keeps the chip out of light sleep, but at the minimum clock
+    // a frame of a long strip would not fit into the frame period
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "render", &pm_lock_);
+    if (err != ESP_OK)
+        return err;
+#endif
+
+    uint32_t period_ms = std::max<uint16_t>(settings_.refresh_time, 1);
+    ESP_LOGI(TAG, "Rendering every %lu ms while animating, core %d, priority %u", static_cast<unsigned long>(period_ms),
+             core == tskNO_AFFINITY ? -1 : static_cast<int>(core), static_cast<unsigned>(priority));
+    // The first frame decides whether the frame timer runs
+    wake();
+    return ESP_OK;
+}
+
+void Renderer::stop()
+{
+    for (esp_timer_handle_t *timer : {&timer_, &deadline_timer_})
+    {
+        if (!*timer)
+            continue;
+        esp_timer_stop(*timer);
+        esp_timer_delete(*timer);
+        *timer = nullptr;
+    }
+    if (pm_lock_)
+    {
+        if (animating_)
+            esp_pm_lock_release(pm_lock_);
+        esp_pm_lock_delete(pm_lock_);
+        pm_lock_ = nullptr;
+    }
+    animating_ = false;
+    if (task_)
+    {
+        vTaskDelete(task_);
+        task_ = nullptr;
+    }
+}
+
+RenderStats Renderer::stats() const
+{
+    taskENTER_CRITICAL(&stats_lock_);
+    RenderStats copy = stats_;
+    taskEXIT_CRITICAL(&stats_lock_);
+    return copy;
+}
+
+void Renderer::reset_stats()
+{
+    taskENTER_CRITICAL(&stats_lock_);
+    stats_ = RenderStats();
+    taskEXIT_CRITICAL(&stats_lock_);
+}
+
+void IRAM_ATTR Renderer::on_tick(void *arg)
+{
+    auto *self = static_cast<Renderer *>(arg);
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+    BaseType_t high_task_wakeup = pdFALSE;
+    vTaskNotifyGiveFromISR(self->task_, &high_task_wakeup);
+    if (high_task_wakeup == pdTRUE)
+        esp_timer_isr_dispatch_need_yield();
+#else
+    xTaskNotifyGive(self->task_);
+#endif
+}
+
+bool Renderer::wait_first_frame(TickType_t timeout)
+{
+    if (xSemaphoreTake(first_frame_, timeout) != pdTRUE)
+        return false;
+    xSemaphoreGive(first_frame_);
+    return true;
+}
+
+void Renderer::wake(int64_t input_us)
+{
+    if (input_us)
+        input_us_.store(input_us);
+    if (task_)
+        xTaskNotifyGive(task_);
+}
+
+void Renderer::task_entry(void *arg)
+{
+    static_cast<Renderer *>(arg)->run();
+}
+
+void Renderer::run()
+{
+    int64_t last_us = 0;
+
+    while (true)
+    {
+        // Woken by the frame timer while animating, otherwise by the next deadline or wake()
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t start_us = esp_timer_get_time();
+        const int64_t period_us = std::max<uint16_t>(settings_.refresh_time, 1) * 1000LL;
+
+        bool was_animating = animating_;
+        int64_t input_us = input_us_.exchange(0);
+        int64_t deadline_us = 0;
+        bool animating = render_frame(start_us, deadline_us);
+        // present() has handed the frame to the output, the wire adds its fixed frame time
+        uint32_t latency_us = input_us ? static_cast<uint32_t>(esp_timer_get_time() - input_us) : 0;
+        schedule(animating, deadline_us);
+
+        uint32_t frame_us = static_cast<uint32_t>(esp_timer_get_time() - start_us);
+        // Jitter only means something between two frames of the frame timer
+        uint32_t jitter_us = was_animating && last_us ? static_cast<uint32_t>(std::llabs(start_us - last_us - period_us)) : 0;
+        last_us = was_animating ? start_us : 0;
+
+        if (stats_.frames == 0)
+            xSemaphoreGive(first_frame_);
+
+        taskENTER_CRITICAL(&stats_lock_);
+        stats_.frames++;
+        stats_.frame_time_us = frame_us;
+        stats_.max_frame_time_us = std::max(stats_.max_frame_time_us, frame_us);
+        stats_.jitter_us = jitter_us;
+        stats_.max_jitter_us = std::max(stats_.max_jitter_us, jitter_us);
+        if (input_us)
+        {
+            stats_.input_latency_us = latency_us;
+            stats_.max_input_latency_us = std::max(stats_.max_input_latency_us, latency_us);
+        }
+        stats_.frames_sent = retired_.frames_sent + strip_->framesSent();
+        stats_.frames_skipped = retired_.frames_skipped + strip_->framesSkipped();
+        stats_.frames_reused = retired_.frames_reused + strip_->framesReused();
+        stats_.strip_rebuilds = retired_.strip_rebuilds;
+        taskEXIT_CRITICAL(&stats_lock_);
+    }
+}
+
+void Renderer::schedule(bool animating, int64_t deadline_us)
+{
+    if (animating != animating_)
+    {
+        if (animating)
+        {
+            if (pm_lock_)
+                esp_pm_lock_acquire(pm_lock_);
+            esp_timer_start_periodic(timer_, std::max<uint16_t>(settings_.refresh_time, 1) * 1000ULL);
+        }
+        else
+        {
+            esp_timer_stop(timer_);
+            if (pm_lock_)
+                esp_pm_lock_release(pm_lock_);
+        }
+        animating_ = animating;
+    }
+
+    esp_timer_stop(deadline_timer_);
+    if (!animating)
+    {
+        int64_t delay_us = std::max<int64_t>(deadline_us - esp_timer_get_time(), 1000);
+        esp_timer_start_once(deadline_timer_, static_cast<uint64_t>(delay_us));
+    }
+}
+
+static bool same_alarm(const SunriseSettings &a, const SunriseSettings &b)
+{
+    return a.alarm_enabled == b.alarm_enabled && a.alarm_hour == b.alarm_hour && a.alarm_minute == b.alarm_minute &&
+           a.duration_minutes == b.duration_minutes && a.duration_on_brightest == b.duration_on_brightest;
+}
+
+int64_t Renderer::update_plan(const SunriseSettings &sunrise, int64_t now_us)
+{
+    // gettimeofday is cheap. Occurrences are only recomputed when the alarms, the clock or
+    // the timezone change, or for the alarm whose occurrence ended, and local time comes
+    // from the schedule's cached DST table.
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int64_t offset_ms = static_cast<int64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000 - now_us / 1000;
+    bool clock_step = std::llabs(offset_ms - epoch_offset_ms_) > CLOCK_STEP_MS;
+    epoch_offset_ms_ = offset_ms;
+
+    int64_t now_ms = now_us / 1000 + epoch_offset_ms_;
+    uint32_t alarms_revision = Settings::get().alarmsRevision();
+    uint32_t timezone_revision = Settings::get().timezoneRevision();
+    if (!schedule_built_ || clock_step || !same_alarm(sunrise, plan_settings_) || alarms_revision != alarms_revision_ ||
+        timezone_revision != timezone_revision_)
+    {
+        // The alarm switch arms the whole schedule. The daily alarm of the sunrise page
+        // applies while no weekly alarms are set. Until SNTP has set the clock (the boot
+        // does not wait for it) nothing is scheduled; setting it is a clock step.
+        std::vector<AlarmEntry> alarms;
+        if (sunrise.alarm_enabled && tv.tv_sec >= CLOCK_VALID_AFTER_S)
+        {
+            alarms = Settings::get().getAlarms();
+            if (alarms.empty())
+                alarms.push_back(Alarm::daily_alarm(sunrise));
+        }
+        schedule_.rebuild(alarms, now_ms);
+        schedule_built_ = true;
+        plan_settings_ = sunrise;
+        alarms_revision_ = alarms_revision;
+        timezone_revision_ = timezone_revision;
+    }
+    else
+    {
+        schedule_.advance(now_ms);
+    }
+
+    plan_valid_ = !schedule_.empty();
+    if (plan_valid_)
+    {
+        plan_ = schedule_.plan();
+        plan_alarm_ = schedule_.alarm();
+    }
+    return now_ms;
+}
+
+Rgb16 Renderer::sunrise_color(const SunriseSettings &sunrise, uint16_t progress)
+{
+    if (sunrise.sunrise_mode == SUNRISE_MODE_KELVIN)
+    {
+        if (!kelvin_curve_.matches(sunrise.kelvin_start, sunrise.kelvin_end))
+            kelvin_curve_.build(sunrise.kelvin_start, sunrise.kelvin_end);
+        return kelvin_curve_.at(progress);
+    }
+
+    if (sunrise.sunrise_mode == SUNRISE_MODE_TIMELINE)
+    {
+        uint32_t revision = Settings::get().timelineRevision();
+        if (!timeline_compiled_ || revision != timeline_revision_)
+        {
+            timeline_.compile(Settings::get().getTimeline());
+            timeline_revision_ = revision;
+            timeline_compiled_ = true;
+        }
+        return timeline_.at(progress);
+    }
+
+    // Ramp brightness perceptually and keep 16 bits until the strip dithers it down
+    uint32_t level = Perceptual::to_linear(progress);
+    return Rgb16{
+        static_cast<uint16_t>((settings_.sunrise_red * 257u * level) >> 16),
+        static_cast<uint16_t>((settings_.sunrise_green * 257u * level) >> 16),
+        static_cast<uint16_t>((settings_.sunrise_blue * 257u * level) >> 16)};
+}
+
+void Renderer::apply_settings()
+{
+    uint32_t revision = Settings::get().lowLevelRevision();
+    if (revision == settings_revision_)
+        return;
+    settings_revision_ = revision;
+    LowLevelSettings updated = Settings::get().getSettings();
+
+    if (!same_strip_layout(settings_, updated))
+    {
+        ESP_LOGI(TAG, "Rebuilding the LED strip: %u LEDs on %u output(s) from GPIO %d, backend %u", updated.num_leds,
+                 updated.led_outputs, updated.pin_led, updated.led_backend);
+        retired_.frames_sent += strip_->framesSent();
+        retired_.frames_skipped += strip_->framesSkipped();
+        retired_.frames_reused += strip_->framesReused();
+        retired_.strip_rebuilds++;
+        // The old strip goes dark and frees its channels before the new one claims them
+        strip_.reset();
+        strip_ = create_strip(updated);
+        if (!strip_->ok())
+        {
+            ESP_LOGE(TAG, "LED strip settings rejected by the driver, keeping the previous layout");
+            strip_.reset();
+            copy_strip_layout(updated, settings_);
+            strip_ = create_strip(updated);
+        }
+        calibration_applied_ = false;
+    }
+    else if (updated.symbol_cache != settings_.symbol_cache)
+    {
+        strip_->setSymbolCache(updated.symbol_cache);
+    }
+
+    if (updated.refresh_time != settings_.refresh_time)
+    {
+        ESP_LOGI(TAG, "Rendering every %u ms while animating", std::max<uint16_t>(updated.refresh_time, 1));
+        if (animating_)
+            esp_timer_restart(timer_, std::max<uint16_t>(updated.refresh_time, 1) * 1000ULL);
+    }
+    settings_ = updated;
+}
+
+bool Renderer::render_frame(int64_t now_us, int64_t &deadline_us)
+{
+    apply_settings();
+
+    uint32_t calibration_revision = Settings::get().calibrationRevision();
+    if (!calibration_applied_ || calibration_revision != calibration_revision_)
+    {
+        strip_->setCalibration(Settings::get().getCalibration());
+        calibration_revision_ = calibration_revision;
+        calibration_applied_ = true;
+    }
+
+    SunriseSettings sunrise = server_.get_settings_copy();
+    int64_t now_ms = update_plan(sunrise, now_us);
+    Alarm::SunrisePhase phase = plan_valid_ ? Alarm::sunrise_phase(plan_, now_ms) : Alarm::SUNRISE_IDLE;
+
+    // The ramp changes every frame and the hold keeps dithering, both need the frame
+    // timer. Preview and off are static until the next transition or settings change.
+    bool animating = phase != Alarm::SUNRISE_IDLE;
+    if (animating)
+    {
+        if (plan_alarm_.sunrise_mode != ALARM_PROFILE_DEFAULT)
+            sunrise.sunrise_mode = plan_alarm_.sunrise_mode;
+        if (plan_alarm_.spatial_mode != ALARM_PROFILE_DEFAULT)
+            sunrise.spatial_mode = plan_alarm_.spatial_mode;
+        uint16_t progress = Alarm::sunrise_progress(now_ms, plan_.start_ms, plan_.full_ms);
+
+        Rgb16 color = sunrise_color(sunrise, progress);
+        if (sunrise.spatial_mode == SPATIAL_UNIFORM)
+            strip_->fill(color);
+        else
+        {
+            uint16_t fill = 0;
+            if (phase == Alarm::SUNRISE_HOLD)
+                fill = Alarm::sunrise_progress(now_ms, plan_.full_ms,
+                                               std::min<int64_t>(plan_.end_ms, plan_.full_ms + SKY_FILL_MS));
+            SpatialKernel::render(strip_->hdrFrame(), static_cast<SpatialMode>(sunrise.spatial_mode), progress, color,
+                                  fill);
+        }
+    }
+    else if (sunrise.light_preview)
+    {
+        strip_->fill(sunrise.red, sunrise.green, sunrise.blue);
+    }
+    else
+    {
+        strip_->clear();
+    }
+
+    bool resync = now_us - last_resync_us_ >= LED_RESYNC_INTERVAL_US;
+    if (resync)
+        last_resync_us_ = now_us;
+    strip_->present(resync);
+
+    // Static picture: sleep until the next transition, but wake for the re-sync and to
+    // notice wall clock steps at least once per re-sync interval
+    int64_t until_us = LED_RESYNC_INTERVAL_US;
+    if (plan_valid_)
+        until_us = std::min(until_us, (Alarm::next_transition(plan_, now_ms) - now_ms) * 1000);
+    deadline_us = now_us + until_us;
+    return animating;
+}
@@ -0,0 +1,62 @@
+#include "SpatialKernel.h"
+#include <algorithm>
+
+namespace SpatialKernel {
+
+// Sky brightness at the origin relative to the sun, Q16
+static constexpr uint32_t kSkyLevel = 22000;
+
+// Renders one ray of `length` LEDs, starting at origin and stepping by dir
+static void render_ray(Rgb16 *origin, int dir, int length, uint16_t progress, const Rgb16 &color, uint16_t fill)
+{
+    if (length <= 0)
+        return;
+
+    const int sun = static_cast<int>((static_cast<uint32_t>(progress) * length) >> 16);
+    const int glow = std::max(length / 6, 1);
+    const int sky_end = sun + glow;
+
+    const uint32_t glow_step = 65535u / glow;
+    const uint32_t sky_step_q8 = (kSkyLevel << 8) / sky_end;
+
+    Rgb16 *out = origin;
+    for (int j = 0; j < length; j++, out += dir)
+    {
+        uint32_t sky = j < sky_end ? kSkyLevel - ((j * sky_step_q8) >> 8) : 0;
+        int dist = j > sun ? j - sun : sun - j;
+        uint32_t sun_level = dist < glow ? 65535u - dist * glow_step : 0;
+        uint32_t level = std::max(sky, sun_level);
+        level += ((65535u - level) * fill) >> 16;
+
+        out->r = static_cast<uint16_t>((color.r * level) >> 16);
+        out->g = static_cast<uint16_t>((color.g * level) >> 16);
+        out->b = static_cast<uint16_t>((color.b * level) >> 16);
+    }
+}
+
+void render(std::span<Rgb16> frame, SpatialMode mode, uint16_t progress, const Rgb16 &color, uint16_t fill)
+{
+    const int n = static_cast<int>(frame.size());
+    if (n == 0)
+        return;
+
+    switch (mode)
+    {
+    case SPATIAL_FROM_END:
+        render_ray(frame.data(), 1, n, progress, color, fill);
+        break;
+    case SPATIAL_FROM_CENTER:
+    {
+        const int mid = n / 2;
+        render_ray(frame.data() + mid, 1, n - mid, progress, color, fill);
+        if (mid > 0)
+            render_ray(frame.data() + mid - 1, -1, mid, progress, color, fill);
+        break;
+    }
+    default:
+        std::fill(frame.begin(), frame.end(), color);
+        break;
+    }
+}
+
+}
@@ -0,0 +1,121 @@
+#include "Timeline.h"
+#include "Perceptual.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct Lab {
+    float l, a, b;
+};
+
+float srgb_to_linear(uint8_t c)
+{
+    float v = c / 255.0f;
+    return v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+}
+
+// OKLab, Björn Ottosson 2020
+Lab linear_to_oklab(float r, float g, float b)
+{
+    float l = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    float m = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    float s = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+    return Lab{
+        0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+        1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+        0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s,
+    };
+}
+
+void oklab_to_linear(const Lab &lab, float &r, float &g, float &b)
+{
+    float l = lab.l + 0.3963377774f * lab.a + 0.2158037573f * lab.b;
+    float m = lab.l - 0.1055613458f * lab.a - 0.0638541728f * lab.b;
+    float s = lab.l - 0.0894841775f * lab.a - 1.2914855480f * lab.b;
+    l = l * l * l;
+    m = m * m * m;
+    s = s * s * s;
+    r = 4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s;
+    g = -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s;
+    b = -0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s;
+}
+
+float ease(uint8_t easing, float t)
+{
+    switch (easing)
+    {
+    case EASING_IN:
+        return t * t;
+    case EASING_OUT:
+        return t * (2.0f - t);
+    case EASING_IN_OUT:
+        return t * t * (3.0f - 2.0f * t);
+    default:
+        return t;
+    }
+}
+
+uint16_t to_channel(float linear, float brightness)
+{
+    return static_cast<uint16_t>(std::clamp(linear, 0.0f, 1.0f) * brightness + 0.5f);
+}
+
+}
+
+void Timeline::compile(const std::vector<Keyframe> &keyframes)
+{
+    if (keyframes.empty())
+    {
+        table_.fill(Rgb16{0, 0, 0});
+        return;
+    }
+
+    std::vector<Keyframe> frames(keyframes);
+    std::stable_sort(frames.begin(), frames.end(), [](const Keyframe &x, const Keyframe &y) { return x.at < y.at; });
+
+    std::vector<Lab> labs;
+    labs.reserve(frames.size());
+    for (const Keyframe &k : frames)
+        labs.push_back(linear_to_oklab(srgb_to_linear(k.red), srgb_to_linear(k.green), srgb_to_linear(k.blue)));
+
+    size_t segment = 0;
+    for (int i = 0; i <= kSteps; i++)
+    {
+        float at = 1000.0f * i / kSteps;
+        while (segment + 1 < frames.size() && frames[segment + 1].at <= at)
+            segment++;
+
+        const Keyframe &from = frames[segment];
+        const Keyframe &to = frames[std::min(segment + 1, frames.size() - 1)];
+        float t = 0.0f;
+        if (to.at > from.at)
+            t = ease(from.easing, std::clamp((at - from.at) / (to.at - from.at), 0.0f, 1.0f));
+
+        const Lab &a = labs[segment];
+        const Lab &b = labs[std::min(segment + 1, frames.size() - 1)];
+        Lab lab{a.l + (b.l - a.l) * t, a.a + (b.a - a.a) * t, a.b + (b.b - a.b) * t};
+
+        float level = from.brightness + (to.brightness - from.brightness) * t;
+        float brightness = Perceptual::to_linear(static_cast<uint16_t>(level * 257.0f + 0.5f));
+
+        float r, g, bl;
+        oklab_to_linear(lab, r, g, bl);
+        table_[i] = Rgb16{to_channel(r, brightness), to_channel(g, brightness), to_channel(bl, brightness)};
+    }
+}
+
+Rgb16 Timeline::at(uint16_t progress) const
+{
+    // Top 8 bits select the step, the low 8 bits interpolate
+    static_assert(kSteps == 256, "index split assumes 256 steps");
+    uint32_t index = progress >> 8;
+    uint32_t frac = progress & 0xFF;
+
+    const Rgb16 &a = table_[index];
+    const Rgb16 &b = table_[index + 1];
+    auto lerp = [frac](uint16_t x, uint16_t y) {
+        return static_cast<uint16_t>(x + ((static_cast<int32_t>(y) - x) * static_cast<int32_t>(frac) >> 8));
+    };
+    return Rgb16{lerp(a.r, b.r), lerp(a.g, b.g), lerp(a.b, b.b)};
+}
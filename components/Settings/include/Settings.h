@@ -2,9 +2,15 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
 #include "esp_err.h"
 #include "driver/gpio.h"
 #include "freertos/semphr.h"
+#include "nvs.h"
+#include "SettingsTypes.h"
+#include "Snapshot.h"
 
 struct __attribute__((packed)) LowLevelSettings {
     uint8_t sunrise_red = 255;
@@ -15,24 +21,15 @@ struct __attribute__((packed)) LowLevelSettings {
     gpio_num_t pin_alarm_switch = GPIO_NUM_18;
     gpio_num_t pin_light_switch = GPIO_NUM_19;
     uint16_t port = 80;
-    uint16_t refresh_time = 1000;
+    uint16_t refresh_time = 20;
     uint16_t cycle_sleep = 1000;
-};
-
-struct SunriseSettings {
-    int red = 255;
-    int green = 100;
-    int blue = 0;
-
-    bool light_preview = false;
-
-    int duration_minutes = 5;
-    int duration_on_brightest = 30;
-    int alarm_hour = 7;
-    int alarm_minute = 30;
-
-    bool alarm_enabled = false;
-    bool disable_hardware_switches = false;
+    // Additional parallel outputs, the strip is split evenly across led_outputs pins
+    uint8_t led_outputs = 1;
+    gpio_num_t pin_led_2 = GPIO_NUM_21;
+    gpio_num_t pin_led_3 = GPIO_NUM_22;
+    gpio_num_t pin_led_4 = GPIO_NUM_23;
+    uint8_t led_backend = 0; // LedBackend in LEDStrip.h: 0 RMT, 1 RMT+DMA, 2 SPI+DMA
+    uint8_t symbol_cache = 0; // keep the encoded RMT frame, 96 bytes per LED
 };
 
 class Settings {
@@ -41,10 +38,56 @@ public:
 
     esp_err_t init();
     esp_err_t load();
+    // Writes the low-level fields that differ from flash, nothing if none changed
     esp_err_t save();
 
+    // Low-level settings are stored one NVS key per field in their own namespace, with a
+    // schema version for migrations. Returns the number of fields written (without
+    // commit), or -1 on error. Public for the benchmark.
+    static int writeChangedFields(nvs_handle_t nvs_handle, const LowLevelSettings &settings,
+                                  const LowLevelSettings &stored, bool all = false);
+
     LowLevelSettings getSettings();
     esp_err_t setSettings(const LowLevelSettings &settings);
+    // Bumped on every setSettings, the renderer and the main loop apply changes live
+    uint32_t lowLevelRevision() const { return settings_.generation(); }
+
+    std::vector<Keyframe> getTimeline();
+    esp_err_t setTimeline(const std::vector<Keyframe> &timeline);
+    // Bumped on every setTimeline, lets the renderer recompile lazily
+    uint32_t timelineRevision() const { return timeline_revision_.load(); }
+
+    // Raw gain triples, see MAX_CALIBRATION_ENTRIES. An empty table disables calibration.
+    std::vector<uint8_t> getCalibration();
+    esp_err_t setCalibration(const std::vector<uint8_t> &calibration);
+    uint32_t calibrationRevision() const { return calibration_revision_.load(); }
+
+    // Weekly alarms in addition to the daily alarm of SunriseSettings, at most MAX_ALARMS
+    std::vector<AlarmEntry> getAlarms();
+    esp_err_t setAlarms(const std::vector<AlarmEntry> &alarms);
+    uint32_t alarmsRevision() const { return alarms_revision_.load(); }
+
+    // Applied to the C library by Alarm, which watches the revision
+    std::string getTimezone();
+    esp_err_t setTimezone(const std::string &timezone);
+    // What setTimezone() accepts, for checking a form before anything is saved
+    static bool isValidTimezone(const std::string &timezone);
+    uint32_t timezoneRevision() const { return timezone_revision_.load(); }
+
+    // Sunrise settings as saved, loaded once at boot for the web server
+    SunriseSettings getSunrise();
+    // Queues a save and returns at once. The writer task waits until no request came in
+    // for debounce_ms (at most max_delay_ms after the first one) and commits only the
+    // last state, so a burst of slider moves costs one commit. Saves synchronously
+    // while the writer is not running.
+    void requestSunriseSave(const SunriseSettings &sunrise);
+    esp_err_t startWriter(BaseType_t core, unsigned priority, uint32_t debounce_ms, uint32_t max_delay_ms);
+
+    struct WriterStats {
+        uint32_t requested;
+        uint32_t commits;
+    };
+    WriterStats writerStats() const { return {save_requests_.load(), save_commits_.load()}; }
 
 private:
     Settings();
@@ -52,6 +95,32 @@ private:
     Settings(const Settings&) = delete;
     Settings& operator=(const Settings&) = delete;
 
-    LowLevelSettings settings_;
-    SemaphoreHandle_t mutex_;
+    Snapshot<LowLevelSettings> settings_;
+    LowLevelSettings stored_;   // what flash holds, for diff writes
+    Published<std::vector<Keyframe>> timeline_;
+    std::atomic<uint32_t> timeline_revision_{0};
+    Published<std::vector<uint8_t>> calibration_;
+    std::atomic<uint32_t> calibration_revision_{0};
+    Published<std::vector<AlarmEntry>> alarms_;
+    std::atomic<uint32_t> alarms_revision_{0};
+    Published<std::string> timezone_{DEFAULT_TIMEZONE};
+    std::atomic<uint32_t> timezone_revision_{0};
+    Snapshot<SunriseSettings> sunrise_; // last requested
+    SunriseSettings sunrise_stored_;   // what flash holds
+    std::atomic<uint32_t> save_requests_{0};
+    std::atomic<uint32_t> save_commits_{0};
+    TaskHandle_t writer_ = nullptr;
+    TickType_t writer_debounce_ = 0;
+    TickType_t writer_max_delay_ = 0;
+    SemaphoreHandle_t mutex_;   // serializes writers, the snapshots are read without it
+
+    esp_err_t loadLowLevel();
+    esp_err_t migrateLowLevel(nvs_handle_t nvs_handle, uint16_t version, LowLevelSettings &settings);
+    esp_err_t loadTimeline(nvs_handle_t nvs_handle);
+    esp_err_t loadCalibration(nvs_handle_t nvs_handle);
+    esp_err_t loadAlarms(nvs_handle_t nvs_handle);
+    esp_err_t loadTimezone(nvs_handle_t nvs_handle);
+    esp_err_t loadSunrise();
+    esp_err_t commitSunrise();
+    static void writerTask(void *arg);
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The plain settings types, without the NVS and FreeRTOS parts of Settings.h, so code
+// that only plans sunrises also builds for the host tools
+
+enum SunriseMode {
+    SUNRISE_MODE_COLOR = 0,  // LowLevelSettings sunrise colour, scaled in brightness
+    SUNRISE_MODE_KELVIN = 1, // black body curve from kelvin_start to kelvin_end
+    SUNRISE_MODE_TIMELINE = 2, // keyframe timeline, see Keyframe
+};
+
+enum SpatialMode {
+    SPATIAL_UNIFORM = 0,    // every LED shows the same colour
+    SPATIAL_FROM_END = 1,   // the sun rises from the first LED towards the last
+    SPATIAL_FROM_CENTER = 2, // the sun grows from the middle of the strip outwards
+};
+
+enum Easing : uint8_t {
+    EASING_LINEAR = 0,
+    EASING_IN = 1,
+    EASING_OUT = 2,
+    EASING_IN_OUT = 3,
+};
+
+// One point of the sunrise timeline. Stored packed in NVS.
+struct __attribute__((packed)) Keyframe {
+    uint16_t at = 0;          // position in the ramp in permille of duration_minutes
+    uint8_t red = 0;          // sRGB colour
+    uint8_t green = 0;
+    uint8_t blue = 0;
+    uint8_t brightness = 0;   // perceptual, 0..255
+    uint8_t easing = EASING_LINEAR; // easing towards the next keyframe
+};
+
+static constexpr size_t MAX_KEYFRAMES = 16;
+
+// Colour calibration: one r, g, b gain triple (255 = unchanged) per entry. A table
+// shorter than the strip is stretched, so 4 entries calibrate 4 equal segments.
+static constexpr size_t MAX_CALIBRATION_ENTRIES = 1024;
+
+// Alarm profile fields set to this follow the sunrise settings
+static constexpr uint8_t ALARM_PROFILE_DEFAULT = 0xFF;
+
+// One entry of the weekly alarm schedule. Stored packed in NVS, 8 bytes each.
+struct __attribute__((packed)) AlarmEntry {
+    uint8_t hour = 7;
+    uint8_t minute = 0;
+    uint8_t weekdays = 0x3E;  // bit n = tm_wday n (0 Sunday), default Monday to Friday
+    uint8_t enabled = 1;
+    // Profile
+    uint8_t duration_minutes = 30;      // ramp
+    uint8_t duration_on_brightest = 30; // hold at full brightness
+    uint8_t sunrise_mode = ALARM_PROFILE_DEFAULT; // SunriseMode
+    uint8_t spatial_mode = ALARM_PROFILE_DEFAULT; // SpatialMode
+};
+
+static constexpr size_t MAX_ALARMS = 32;
+
+// POSIX TZ rule, e.g. "CET-1CEST,M3.5.0,M10.5.0/3"
+static constexpr size_t MAX_TIMEZONE_LENGTH = 64;
+static constexpr const char *DEFAULT_TIMEZONE = "CET-1CEST,M3.5.0,M10.5.0/3";
+
+struct SunriseSettings {
+    int red = 255;
+    int green = 100;
+    int blue = 0;
+
+    bool light_preview = false;
+
+    int duration_minutes = 5;
+    int duration_on_brightest = 30;
+    int alarm_hour = 7;
+    int alarm_minute = 30;
+
+    bool alarm_enabled = false;
+    bool disable_hardware_switches = false;
+
+    int sunrise_mode = SUNRISE_MODE_COLOR;
+    int kelvin_start = 1000;
+    int kelvin_end = 6500;
+
+    int spatial_mode = SPATIAL_UNIFORM;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+// Wait-free for writers, lock-free for readers: a value published through two seqlocked
+// slots. store() fills the slot readers are not using and then flips the generation, so
+// a reader never waits for a writer that was preempted mid-copy (the render task outranks
+// every writer, on a single core a plain seqlock would spin forever). A read retries only
+// if two complete stores land while it copies. It never sees a torn or default value.
+//
+// Writers must be serialized by the caller, e.g. with a mutex only they take.
+template <typename T>
+class Snapshot {
+    static_assert(std::is_trivially_copyable_v<T>, "Snapshot copies the value word by word");
+
+public:
+    explicit Snapshot(const T &initial = T{}) {
+        write(slots_[0], initial);
+        write(slots_[1], initial);
+    }
+
+    T load() const {
+        for (;;) {
+            const Slot &slot = slots_[generation_.load(std::memory_order_acquire) & 1];
+            uint32_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq & 1)
+                continue; // lapped by two stores, the other slot is current again
+            uint32_t words[kWords];
+            for (size_t i = 0; i < kWords; i++)
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == seq) {
+                T value;
+                memcpy(&value, words, sizeof(T));
+                return value;
+            }
+        }
+    }
+
+    void store(const T &value) {
+        uint32_t generation = generation_.load(std::memory_order_relaxed);
+        write(slots_[(generation + 1) & 1], value);
+        generation_.store(generation + 1, std::memory_order_release);
+    }
+
+    // Bumped by every store
+    uint32_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    struct Slot {
+        std::atomic<uint32_t> seq{0}; // odd while being written
+        std::atomic<uint32_t> words[kWords];
+    };
+
+    static void write(Slot &slot, const T &value) {
+        uint32_t words[kWords] = {};
+        memcpy(words, &value, sizeof(T));
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; i++)
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    Slot slots_[2];
+    std::atomic<uint32_t> generation_{0};
+};
+
+// The same idea for values that own memory (vectors, strings), which cannot be copied
+// word by word: each slot holds an immutable heap copy plus a count of the readers
+// inside it. load() registers in the current slot and copies the value; it only
+// retries if a store flipped the slots in between. store() replaces the slot readers
+// are not using and waits (sleeping, writers may block) until readers that still
+// registered there have left. Readers never wait for a writer and never see a
+// partial or default value.
+//
+// Writers must be serialized by the caller.
+template <typename T>
+class Published {
+public:
+    explicit Published(const T &initial = T{}) {
+        slots_[0].value.store(new T(initial));
+        slots_[1].value.store(new T(initial));
+    }
+    ~Published() {
+        delete slots_[0].value.load();
+        delete slots_[1].value.load();
+    }
+    Published(const Published &) = delete;
+    Published &operator=(const Published &) = delete;
+
+    T load() const {
+        for (;;) {
+            uint32_t generation = generation_.load();
+            const Slot &slot = slots_[generation & 1];
+            slot.readers++;
+            // A store that passed its reader check before the increment has not
+            // flipped to this slot yet, so the generation tells it apart
+            if (generation_.load() == generation) {
+                T value = *slot.value.load();
+                slot.readers--;
+                return value;
+            }
+            slot.readers--;
+        }
+    }
+
+    void store(const T &value) {
+        T *next = new T(value);
+        uint32_t generation = generation_.load();
+        Slot &slot = slots_[(generation + 1) & 1];
+        while (slot.readers.load() != 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        delete slot.value.exchange(next);
+        generation_.store(generation + 1);
+    }
+
+    // Bumped by every store
+    uint32_t generation() const { return generation_.load(); }
+
+private:
+    struct Slot {
+        std::atomic<T *> value{nullptr};
+        mutable std::atomic<uint32_t> readers{0};
+    };
+
+    Slot slots_[2];
+    std::atomic<uint32_t> generation_{0};
+};
@@ -2,9 +2,129 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <span>
 
 static const char *TAG = "Settings";
 
+// Bump when a field changes meaning or type and add the step to migrateLowLevel().
+// New fields need no migration, a missing key keeps the default.
+#define LOW_LEVEL_SCHEMA_VERSION 2
+#define LOW_LEVEL_NAMESPACE "lowlevel"
+
+#define SUNRISE_NAMESPACE "sunrise"
+
+// One struct member stored under its own NVS key
+struct NvsField {
+    const char *key; // NVS keys are at most 15 characters
+    size_t offset;
+    size_t size;     // 1: u8, 2: u16, 4: i32
+};
+
+#define NVS_FIELD(type, key, member) {key, offsetof(type, member), sizeof(type::member)}
+#define LOW_LEVEL_FIELD(key, member) NVS_FIELD(LowLevelSettings, key, member)
+#define SUNRISE_FIELD(key, member) NVS_FIELD(SunriseSettings, key, member)
+
+static const NvsField LOW_LEVEL_FIELDS[] = {
+    LOW_LEVEL_FIELD("red", sunrise_red),
+    LOW_LEVEL_FIELD("green", sunrise_green),
+    LOW_LEVEL_FIELD("blue", sunrise_blue),
+    LOW_LEVEL_FIELD("num_leds", num_leds),
+    LOW_LEVEL_FIELD("pin_led", pin_led),
+    LOW_LEVEL_FIELD("pin_alarm", pin_alarm_switch),
+    LOW_LEVEL_FIELD("pin_light", pin_light_switch),
+    LOW_LEVEL_FIELD("port", port),
+    LOW_LEVEL_FIELD("refresh", refresh_time),
+    LOW_LEVEL_FIELD("cycle_sleep", cycle_sleep),
+    LOW_LEVEL_FIELD("outputs", led_outputs),
+    LOW_LEVEL_FIELD("pin_led_2", pin_led_2),
+    LOW_LEVEL_FIELD("pin_led_3", pin_led_3),
+    LOW_LEVEL_FIELD("pin_led_4", pin_led_4),
+    LOW_LEVEL_FIELD("backend", led_backend),
+    LOW_LEVEL_FIELD("sym_cache", symbol_cache),
+};
+
+// light_preview is left out on purpose, a reboot should not switch the lamp on
+static const NvsField SUNRISE_FIELDS[] = {
+    SUNRISE_FIELD("red", red),
+    SUNRISE_FIELD("green", green),
+    SUNRISE_FIELD("blue", blue),
+    SUNRISE_FIELD("duration", duration_minutes),
+    SUNRISE_FIELD("on_brightest", duration_on_brightest),
+    SUNRISE_FIELD("hour", alarm_hour),
+    SUNRISE_FIELD("minute", alarm_minute),
+    SUNRISE_FIELD("enabled", alarm_enabled),
+    SUNRISE_FIELD("no_switches", disable_hardware_switches),
+    SUNRISE_FIELD("mode", sunrise_mode),
+    SUNRISE_FIELD("kelvin_start", kelvin_start),
+    SUNRISE_FIELD("kelvin_end", kelvin_end),
+    SUNRISE_FIELD("spatial", spatial_mode),
+};
+
+static esp_err_t read_field(nvs_handle_t nvs_handle, const NvsField &field, void *base) {
+    uint8_t *dst = static_cast<uint8_t *>(base) + field.offset;
+    esp_err_t err = ESP_ERR_INVALID_SIZE;
+    if (field.size == 1) {
+        uint8_t value;
+        err = nvs_get_u8(nvs_handle, field.key, &value);
+        if (err == ESP_OK) memcpy(dst, &value, sizeof(value));
+    } else if (field.size == 2) {
+        uint16_t value;
+        err = nvs_get_u16(nvs_handle, field.key, &value);
+        if (err == ESP_OK) memcpy(dst, &value, sizeof(value));
+    } else if (field.size == 4) {
+        int32_t value;
+        err = nvs_get_i32(nvs_handle, field.key, &value);
+        if (err == ESP_OK) memcpy(dst, &value, sizeof(value));
+    }
+    return err;
+}
+
+static esp_err_t write_field(nvs_handle_t nvs_handle, const NvsField &field, const void *base) {
+    const uint8_t *src = static_cast<const uint8_t *>(base) + field.offset;
+    if (field.size == 1) {
+        uint8_t value;
+        memcpy(&value, src, sizeof(value));
+        return nvs_set_u8(nvs_handle, field.key, value);
+    }
+    if (field.size == 2) {
+        uint16_t value;
+        memcpy(&value, src, sizeof(value));
+        return nvs_set_u16(nvs_handle, field.key, value);
+    }
+    if (field.size == 4) {
+        int32_t value;
+        memcpy(&value, src, sizeof(value));
+        return nvs_set_i32(nvs_handle, field.key, value);
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
+
+static void read_fields(nvs_handle_t nvs_handle, std::span<const NvsField> fields, void *base) {
+    for (const NvsField &field : fields) {
+        esp_err_t err = read_field(nvs_handle, field, base);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+            ESP_LOGW(TAG, "Feld %s ungültig (%s), Standardwert wird genutzt", field.key, esp_err_to_name(err));
+    }
+}
+
+// Returns the number of fields written, -1 on error
+static int write_fields(nvs_handle_t nvs_handle, std::span<const NvsField> fields, const void *now,
+                        const void *was, bool all) {
+    int written = 0;
+    for (const NvsField &field : fields) {
+        if (!all && memcmp(static_cast<const uint8_t *>(now) + field.offset,
+                           static_cast<const uint8_t *>(was) + field.offset, field.size) == 0)
+            continue;
+        if (write_field(nvs_handle, field, now) != ESP_OK)
+            return -1;
+        written++;
+    }
+    return written;
+}
+
 Settings& Settings::get() {
     static Settings instance;
     return instance;
@@ -12,6 +132,14 @@ Settings& Settings::get() {
 
 Settings::Settings() {
     mutex_ = xSemaphoreCreateMutex();
+
+    // Default timeline: deep red dawn, orange sunrise, warm white daylight
+    timeline_.store({
+        {0, 255, 20, 0, 0, EASING_IN},
+        {300, 255, 60, 0, 90, EASING_LINEAR},
+        {700, 255, 140, 40, 190, EASING_OUT},
+        {1000, 255, 214, 170, 255, EASING_LINEAR},
+    });
 }
 
 Settings::~Settings() {
@@ -26,53 +154,412 @@ esp_err_t Settings::init()
 }
 
 esp_err_t Settings::load() {
+    // Every part falls back to its defaults on its own, one unreadable entry must not
+    // cost the others. The parts log their failures, the first one is returned.
+    esp_err_t result = ESP_OK;
+    auto keep_first = [&result](esp_err_t err) {
+        if (result == ESP_OK)
+            result = err;
+    };
+
+    keep_first(loadLowLevel());
+    keep_first(loadSunrise());
+
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS öffnen fehlgeschlagen: %s", esp_err_to_name(err));
+        keep_first(err);
+        return result;
+    }
+
+    keep_first(loadTimeline(nvs_handle));
+    keep_first(loadCalibration(nvs_handle));
+    keep_first(loadAlarms(nvs_handle));
+    keep_first(loadTimezone(nvs_handle));
+
+    nvs_close(nvs_handle);
+    return result;
+}
+
+esp_err_t Settings::loadLowLevel() {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(LOW_LEVEL_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "NVS öffnen fehlgeschlagen: %s", esp_err_to_name(err));
         return err;
     }
 
-    size_t required_size = sizeof(settings_);
-    err = nvs_get_blob(nvs_handle, "lls", &settings_, &required_size);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(TAG, "Keine gespeicherten Settings gefunden, Standardwerte werden genutzt");
-        err = ESP_OK;
-    } else if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Fehler beim Laden der Settings: %s", esp_err_to_name(err));
+    uint16_t version = 0;
+    err = nvs_get_u16(nvs_handle, "version", &version);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGE(TAG, "Fehler beim Laden der Settings-Version: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        return err;
     }
 
+    LowLevelSettings settings;
+    read_fields(nvs_handle, LOW_LEVEL_FIELDS, &settings);
+    stored_ = settings;
+
+    err = ESP_OK;
+    if (version < LOW_LEVEL_SCHEMA_VERSION)
+        err = migrateLowLevel(nvs_handle, version, settings);
+    else if (version > LOW_LEVEL_SCHEMA_VERSION)
+        ESP_LOGW(TAG, "Settings-Version %u ist neuer als diese Firmware (%u)", version, LOW_LEVEL_SCHEMA_VERSION);
+    settings_.store(settings);
+
     nvs_close(nvs_handle);
     return err;
 }
 
+esp_err_t Settings::loadSunrise() {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(SUNRISE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS öffnen fehlgeschlagen: %s", esp_err_to_name(err));
+        return err;
+    }
+    SunriseSettings sunrise;
+    read_fields(nvs_handle, SUNRISE_FIELDS, &sunrise);
+    sunrise_.store(sunrise);
+    sunrise_stored_ = sunrise;
+    nvs_close(nvs_handle);
+    return ESP_OK;
+}
+
+esp_err_t Settings::migrateLowLevel(nvs_handle_t nvs_handle, uint16_t version, LowLevelSettings &settings) {
+    ESP_LOGI(TAG, "Settings-Migration von Version %u auf %u", version, LOW_LEVEL_SCHEMA_VERSION);
+
+    nvs_handle_t legacy = 0;
+    bool has_legacy = false;
+    if (version == 0 && nvs_open("storage", NVS_READWRITE, &legacy) == ESP_OK) {
+        // Up to version 0 the struct was one packed "lls" blob. Fields were only ever
+        // appended, so a shorter blob is a valid prefix and the rest keeps its defaults.
+        has_legacy = true;
+        size_t size = 0;
+        if (nvs_get_blob(legacy, "lls", nullptr, &size) == ESP_OK && size <= sizeof(settings)) {
+            LowLevelSettings blob = settings;
+            if (nvs_get_blob(legacy, "lls", &blob, &size) == ESP_OK) {
+                settings = blob;
+                ESP_LOGI(TAG, "Alte Settings (%u Bytes) übernommen", static_cast<unsigned>(size));
+            }
+        }
+    }
+    if (version < 2 && settings.refresh_time == 1000) {
+        // The pre-render-task default, carried over from the "lls" blob. It makes every
+        // sunrise step visible; other values were chosen on purpose and are kept.
+        settings.refresh_time = LowLevelSettings().refresh_time;
+        ESP_LOGI(TAG, "refresh_time 1000 -> %u ms", settings.refresh_time);
+    }
+    // Later steps go here, e.g. if (version < 3) { ... }
+
+    // Version 0 writes every field so the defaults are pinned as well
+    esp_err_t err = writeChangedFields(nvs_handle, settings, stored_, version == 0) < 0 ? ESP_FAIL : ESP_OK;
+    if (err == ESP_OK)
+        err = nvs_set_u16(nvs_handle, "version", LOW_LEVEL_SCHEMA_VERSION);
+    if (err == ESP_OK)
+        err = nvs_commit(nvs_handle);
+
+    if (err == ESP_OK) {
+        stored_ = settings;
+        // Only dropped once the fields are committed, a reset in between migrates again
+        if (has_legacy && nvs_erase_key(legacy, "lls") == ESP_OK)
+            nvs_commit(legacy);
+    } else {
+        ESP_LOGE(TAG, "Settings-Migration fehlgeschlagen: %s", esp_err_to_name(err));
+    }
+    if (has_legacy)
+        nvs_close(legacy);
+    return err;
+}
+
+int Settings::writeChangedFields(nvs_handle_t nvs_handle, const LowLevelSettings &settings,
+                                 const LowLevelSettings &stored, bool all) {
+    return write_fields(nvs_handle, LOW_LEVEL_FIELDS, &settings, &stored, all);
+}
+
+esp_err_t Settings::loadTimeline(nvs_handle_t nvs_handle) {
+    Keyframe frames[MAX_KEYFRAMES];
+    size_t size = sizeof(frames);
+    esp_err_t err = nvs_get_blob(nvs_handle, "tl", frames, &size);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        return ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Fehler beim Laden der Timeline: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    size_t count = size / sizeof(Keyframe);
+    if (count >= 2)
+        timeline_.store(std::vector<Keyframe>(frames, frames + count));
+    return ESP_OK;
+}
+
+esp_err_t Settings::loadCalibration(nvs_handle_t nvs_handle) {
+    size_t size = 0;
+    esp_err_t err = nvs_get_blob(nvs_handle, "cal", nullptr, &size);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        return ESP_OK;
+    if (err == ESP_OK && (size % 3 != 0 || size > MAX_CALIBRATION_ENTRIES * 3))
+        err = ESP_ERR_INVALID_SIZE;
+    std::vector<uint8_t> calibration(size);
+    if (err == ESP_OK)
+        err = nvs_get_blob(nvs_handle, "cal", calibration.data(), &size);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Fehler beim Laden der Kalibrierung: %s", esp_err_to_name(err));
+        return err;
+    }
+    calibration_.store(calibration);
+    return ESP_OK;
+}
+
+esp_err_t Settings::loadAlarms(nvs_handle_t nvs_handle) {
+    AlarmEntry alarms[MAX_ALARMS];
+    size_t size = sizeof(alarms);
+    esp_err_t err = nvs_get_blob(nvs_handle, "alarms", alarms, &size);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        return ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Fehler beim Laden der Wecker: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    alarms_.store(std::vector<AlarmEntry>(alarms, alarms + size / sizeof(AlarmEntry)));
+    return ESP_OK;
+}
+
+esp_err_t Settings::loadTimezone(nvs_handle_t nvs_handle) {
+    char timezone[MAX_TIMEZONE_LENGTH + 1];
+    size_t size = sizeof(timezone);
+    esp_err_t err = nvs_get_str(nvs_handle, "tz", timezone, &size);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        return ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Fehler beim Laden der Zeitzone: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    timezone_.store(timezone);
+    timezone_revision_++;
+    return ESP_OK;
+}
+
 esp_err_t Settings::save() {
+    LowLevelSettings settings = settings_.load();
+
     nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    esp_err_t err = nvs_open(LOW_LEVEL_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) return err;
 
-    err = nvs_set_blob(nvs_handle, "lls", &settings_, sizeof(settings_));
-    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+    // Unchanged fields cost neither a flash write nor a commit
+    int written = writeChangedFields(nvs_handle, settings, stored_);
+    if (written < 0) err = ESP_FAIL;
+    if (err == ESP_OK && written > 0) err = nvs_commit(nvs_handle);
+    if (err == ESP_OK) stored_ = settings;
 
     nvs_close(nvs_handle);
     return err;
 }
 
 LowLevelSettings Settings::getSettings() {
-    LowLevelSettings copy;
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(10)) == pdTRUE) {
-        copy = settings_;
-        xSemaphoreGive(mutex_);
-    }
-    return copy;
+    return settings_.load();
 }
 
 esp_err_t Settings::setSettings(const LowLevelSettings &settings) {
+    // Only writers take the mutex, readers go through the snapshot
     if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(50)) != pdTRUE)
         return ESP_FAIL;
 
-    settings_ = settings;
+    settings_.store(settings);
     xSemaphoreGive(mutex_);
 
     return save();
 }
+
+std::vector<Keyframe> Settings::getTimeline() {
+    return timeline_.load();
+}
+
+esp_err_t Settings::setTimeline(const std::vector<Keyframe> &timeline) {
+    if (timeline.size() < 2 || timeline.size() > MAX_KEYFRAMES)
+        return ESP_ERR_INVALID_ARG;
+
+    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(50)) != pdTRUE)
+        return ESP_FAIL;
+    timeline_.store(timeline);
+    xSemaphoreGive(mutex_);
+    timeline_revision_++;
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    err = nvs_set_blob(nvs_handle, "tl", timeline.data(), timeline.size() * sizeof(Keyframe));
+    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+std::vector<uint8_t> Settings::getCalibration() {
+    return calibration_.load();
+}
+
+esp_err_t Settings::setCalibration(const std::vector<uint8_t> &calibration) {
+    if (calibration.size() % 3 != 0 || calibration.size() > MAX_CALIBRATION_ENTRIES * 3)
+        return ESP_ERR_INVALID_ARG;
+
+    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(50)) != pdTRUE)
+        return ESP_FAIL;
+    calibration_.store(calibration);
+    xSemaphoreGive(mutex_);
+    calibration_revision_++;
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    if (calibration.empty()) {
+        err = nvs_erase_key(nvs_handle, "cal");
+        if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+    } else {
+        err = nvs_set_blob(nvs_handle, "cal", calibration.data(), calibration.size());
+    }
+    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+std::vector<AlarmEntry> Settings::getAlarms() {
+    return alarms_.load();
+}
+
+esp_err_t Settings::setAlarms(const std::vector<AlarmEntry> &alarms) {
+    if (alarms.size() > MAX_ALARMS)
+        return ESP_ERR_INVALID_ARG;
+
+    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(50)) != pdTRUE)
+        return ESP_FAIL;
+    alarms_.store(alarms);
+    xSemaphoreGive(mutex_);
+    alarms_revision_++;
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    if (alarms.empty()) {
+        err = nvs_erase_key(nvs_handle, "alarms");
+        if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+    } else {
+        err = nvs_set_blob(nvs_handle, "alarms", alarms.data(), alarms.size() * sizeof(AlarmEntry));
+    }
+    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+std::string Settings::getTimezone() {
+    return timezone_.load();
+}
+
+bool Settings::isValidTimezone(const std::string &timezone) {
+    // The characters of POSIX TZ rules, including <+03>-3 style quoted names
+    return !timezone.empty() && timezone.size() <= MAX_TIMEZONE_LENGTH &&
+           timezone.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+-,./:<>") == std::string::npos;
+}
+
+esp_err_t Settings::setTimezone(const std::string &timezone) {
+    if (!isValidTimezone(timezone))
+        return ESP_ERR_INVALID_ARG;
+
+    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(50)) != pdTRUE)
+        return ESP_FAIL;
+    timezone_.store(timezone);
+    xSemaphoreGive(mutex_);
+    timezone_revision_++;
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    err = nvs_set_str(nvs_handle, "tz", timezone.c_str());
+    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+SunriseSettings Settings::getSunrise() {
+    return sunrise_.load();
+}
+
+void Settings::requestSunriseSave(const SunriseSettings &sunrise) {
+    // Held only for the store, a timeout would drop the save
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    sunrise_.store(sunrise);
+    xSemaphoreGive(mutex_);
+    save_requests_++;
+
+    if (writer_)
+        xTaskNotifyGive(writer_);
+    else
+        commitSunrise();
+}
+
+esp_err_t Settings::commitSunrise() {
+    SunriseSettings sunrise = sunrise_.load();
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(SUNRISE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+
+    // A burst that ends where it started (slider moved and back) writes nothing
+    int written = write_fields(nvs_handle, SUNRISE_FIELDS, &sunrise, &sunrise_stored_, false);
+    if (written < 0) err = ESP_FAIL;
+    if (err == ESP_OK && written > 0) {
+        err = nvs_commit(nvs_handle);
+        if (err == ESP_OK) save_commits_++;
+    }
+    if (err == ESP_OK)
+        sunrise_stored_ = sunrise;
+    else
+        ESP_LOGE(TAG, "Fehler beim Speichern der Sunrise-Settings: %s", esp_err_to_name(err));
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t Settings::startWriter(BaseType_t core, unsigned priority, uint32_t debounce_ms, uint32_t max_delay_ms) {
+    if (writer_)
+        return ESP_OK;
+    writer_debounce_ = std::max<TickType_t>(pdMS_TO_TICKS(debounce_ms), 1);
+    writer_max_delay_ = std::max(pdMS_TO_TICKS(max_delay_ms), writer_debounce_);
+    if (xTaskCreatePinnedToCore(writerTask, "settings", 3072, this, priority, &writer_, core) != pdPASS) {
+        writer_ = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void Settings::writerTask(void *arg) {
+    Settings *self = static_cast<Settings *>(arg);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Wait for a quiet period, but do not let a steady stream of changes hold off
+        // the commit for longer than the maximum delay
+        const TickType_t first = xTaskGetTickCount();
+        for (;;) {
+            TickType_t elapsed = xTaskGetTickCount() - first;
+            if (elapsed >= self->writer_max_delay_)
+                break;
+            if (ulTaskNotifyTake(pdTRUE, std::min(self->writer_debounce_, self->writer_max_delay_ - elapsed)) == 0)
+                break;
+        }
+        self->commitSunrise();
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+#include "driver/gpio_filter.h"
+#endif
+
+enum SwitchId : uint8_t {
+    SWITCH_ALARM = 0,
+    SWITCH_LIGHT = 1,
+    SWITCH_COUNT,
+};
+
+struct SwitchEvent {
+    SwitchId id;
+    bool on;          // pin level high
+    int64_t edge_us;  // esp_timer time of the interrupt
+};
+
+// The alarm and light switches as debounced edge events. The first edge is reported
+// straight from the interrupt (leading edge debounce), then the pin is ignored for
+// debounce_ms while it bounces and re-armed against the level it settled at. A flip
+// back within the window is reported once the window ends. The interrupt is a level
+// interrupt on the level the switch does not have, so it also ends a light sleep.
+class Switches {
+public:
+    // notify_task: see set_notify_task(). Given here it also gets the events start()
+    // queues for the initial switch positions.
+    Switches(int alarm_pin, int light_pin, uint32_t debounce_ms, TaskHandle_t notify_task = nullptr);
+    ~Switches();
+
+    // Without the GPIO ISR service the switches still work through poll()
+    esp_err_t start();
+    // Compares the pins with the last reported levels and queues the differences
+    void poll();
+    bool receive(SwitchEvent &event, TickType_t timeout);
+    // Also gives this task a notification for every interrupt event, so it can wait for
+    // switch events and other work at once and drain receive() with a zero timeout
+    void set_notify_task(TaskHandle_t task) { notify_task_ = task; }
+    bool level(SwitchId id) const { return inputs_[id].level; }
+
+private:
+    struct Input {
+        Switches *owner;
+        SwitchId id;
+        gpio_num_t pin;
+        volatile bool level;  // last reported level
+        esp_timer_handle_t debounce;
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+        gpio_glitch_filter_handle_t filter;
+#endif
+    };
+
+    Input inputs_[SWITCH_COUNT];
+    uint32_t debounce_us_;
+    QueueHandle_t events_;
+    bool interrupts_;
+    TaskHandle_t notify_task_ = nullptr;
+
+    void arm(Input &input);
+    static void on_edge(void *arg);
+    static void on_settled(void *arg);
+};
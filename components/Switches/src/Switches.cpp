@@ -0,0 +1,141 @@
+#include "Switches.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+
+static const char *TAG = "Switches";
+
+#define SWITCH_EVENT_QUEUE_LENGTH 8
+
+Switches::Switches(int alarm_pin, int light_pin, uint32_t debounce_ms, TaskHandle_t notify_task)
+    : inputs_{{this, SWITCH_ALARM, static_cast<gpio_num_t>(alarm_pin), false, nullptr},
+              {this, SWITCH_LIGHT, static_cast<gpio_num_t>(light_pin), false, nullptr}},
+      debounce_us_(debounce_ms * 1000), events_(xQueueCreate(SWITCH_EVENT_QUEUE_LENGTH, sizeof(SwitchEvent))),
+      interrupts_(false), notify_task_(notify_task)
+{
+    gpio_config_t io_conf = {
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE};
+
+    for (Input &input : inputs_)
+    {
+        io_conf.pin_bit_mask = 1ULL << input.pin;
+        gpio_config(&io_conf);
+        // The first poll() or interrupt reports the initial position
+        input.level = !gpio_get_level(input.pin);
+    }
+}
+
+Switches::~Switches()
+{
+    for (Input &input : inputs_)
+    {
+        if (interrupts_)
+        {
+            gpio_isr_handler_remove(input.pin);
+            gpio_wakeup_disable(input.pin);
+        }
+        if (input.debounce)
+        {
+            esp_timer_stop(input.debounce);
+            esp_timer_delete(input.debounce);
+        }
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+        // The chip has only a few filters, a rebuilt Switches needs them again
+        if (input.filter)
+        {
+            gpio_glitch_filter_disable(input.filter);
+            gpio_del_glitch_filter(input.filter);
+        }
+#endif
+    }
+    vQueueDelete(events_);
+}
+
+esp_err_t Switches::start()
+{
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+    {
+        ESP_LOGW(TAG, "GPIO ISR service failed (%s), polling the switches", esp_err_to_name(err));
+        return err;
+    }
+
+    for (Input &input : inputs_)
+    {
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+        // Drops spikes of a few clock cycles in hardware, the bounce is handled below
+        gpio_pin_glitch_filter_config_t filter_config = {};
+        filter_config.clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT;
+        filter_config.gpio_num = input.pin;
+        if (gpio_new_pin_glitch_filter(&filter_config, &input.filter) == ESP_OK)
+            gpio_glitch_filter_enable(input.filter);
+        else
+            input.filter = nullptr;
+#endif
+        esp_timer_create_args_t timer_args = {};
+        timer_args.callback = on_settled;
+        timer_args.arg = &input;
+        timer_args.dispatch_method = ESP_TIMER_TASK;
+        timer_args.name = "switch_debounce";
+        err = esp_timer_create(&timer_args, &input.debounce);
+        if (err == ESP_OK)
+            err = gpio_isr_handler_add(input.pin, on_edge, &input);
+        if (err != ESP_OK)
+            return err;
+        arm(input);
+    }
+    esp_sleep_enable_gpio_wakeup();
+    interrupts_ = true;
+    ESP_LOGI(TAG, "Switches on GPIO %d and %d, debounce %lu ms", inputs_[SWITCH_ALARM].pin,
+             inputs_[SWITCH_LIGHT].pin, static_cast<unsigned long>(debounce_us_ / 1000));
+    return ESP_OK;
+}
+
+void Switches::arm(Input &input)
+{
+    // gpio_wakeup_enable sets the interrupt type too, so the same level ends a light sleep.
+    // If the pin already moved on, the interrupt fires right away.
+    gpio_wakeup_enable(input.pin, input.level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    gpio_intr_enable(input.pin);
+}
+
+void Switches::on_edge(void *arg)
+{
+    auto *input = static_cast<Input *>(arg);
+    gpio_intr_disable(input->pin);
+
+    input->level = !input->level;
+    SwitchEvent event = {input->id, input->level, esp_timer_get_time()};
+    BaseType_t high_task_wakeup = pdFALSE;
+    xQueueSendFromISR(input->owner->events_, &event, &high_task_wakeup);
+    if (input->owner->notify_task_)
+        vTaskNotifyGiveFromISR(input->owner->notify_task_, &high_task_wakeup);
+    esp_timer_start_once(input->debounce, input->owner->debounce_us_);
+    portYIELD_FROM_ISR(high_task_wakeup);
+}
+
+void Switches::on_settled(void *arg)
+{
+    auto *input = static_cast<Input *>(arg);
+    input->owner->arm(*input);
+}
+
+void Switches::poll()
+{
+    for (Input &input : inputs_)
+    {
+        bool level = gpio_get_level(input.pin);
+        if (level == input.level)
+            continue;
+        input.level = level;
+        SwitchEvent event = {input.id, level, esp_timer_get_time()};
+        xQueueSend(events_, &event, 0);
+    }
+}
+
+bool Switches::receive(SwitchEvent &event, TickType_t timeout)
+{
+    return xQueueReceive(events_, &event, timeout) == pdTRUE;
+}
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <string>
 #include "esp_err.h"
 #include "esp_http_server.h"
 #include "Settings.h"
+#include "Snapshot.h"
 
 class WebServer
 {
@@ -12,8 +14,12 @@ public:
     explicit WebServer(uint16_t port = 80);
     ~WebServer();
 
-    esp_err_t start();
+    esp_err_t start(BaseType_t core = tskNO_AFFINITY, unsigned priority = tskIDLE_PRIORITY + 5, size_t stack_size = 8192);
     esp_err_t stop();
+    // Moves a running server to another port with the parameters of start(); before
+    // start() only the port is remembered. Must not be called from a handler.
+    esp_err_t restart(uint16_t port);
+    uint16_t port() const { return port_; }
 
     SunriseSettings get_settings_copy() const;
     esp_err_t handle_root_get(httpd_req_t *req);
@@ -22,6 +28,18 @@ public:
     esp_err_t serve_static(httpd_req_t *req);
     esp_err_t handle_low_level_settings_post(httpd_req_t *req);
     esp_err_t handle_low_level_settings_get(httpd_req_t *req);
+    esp_err_t handle_timeline_get(httpd_req_t *req);
+    esp_err_t handle_timeline_post(httpd_req_t *req);
+    esp_err_t handle_calibration_get(httpd_req_t *req);
+    esp_err_t handle_calibration_post(httpd_req_t *req);
+    esp_err_t handle_calibration_delete(httpd_req_t *req);
+    esp_err_t handle_alarms_get(httpd_req_t *req);
+    esp_err_t handle_alarms_post(httpd_req_t *req);
+
+    // Called from the HTTP or caller task whenever the sunrise settings, timeline,
+    // alarms, calibration or low-level settings change, so consumers can react
+    // without polling
+    void set_change_callback(std::function<void()> callback) { change_callback_ = std::move(callback); }
 
     void set_alarm_enabled(bool enabled);
     bool get_alarm_enabled() const;
@@ -30,14 +48,22 @@ public:
 
 private:
     uint16_t port_;
-    SunriseSettings settings_;
-    mutable SemaphoreHandle_t settings_mutex_;
+    BaseType_t core_ = tskNO_AFFINITY;
+    unsigned priority_ = tskIDLE_PRIORITY + 5;
+    size_t stack_size_ = 8192;
+    Snapshot<SunriseSettings> settings_;
+    SemaphoreHandle_t settings_mutex_; // serializes writers of settings_
     httpd_handle_t server_;
+    std::function<void()> change_callback_;
 
     esp_err_t register_uri_handlers();
+    void notify_change();
+    // Read-modify-write of settings_; change returns whether it modified the copy
+    bool update_settings(const std::function<bool(SunriseSettings &)> &change);
     std::string generate_gpio_options(gpio_num_t selected_pin);
     std::string build_html_with_settings(const SunriseSettings &settings);
     std::string build_low_level_settings_html(const LowLevelSettings &s);
 
     static std::string replace_all(std::string str, const std::string &from, const std::string &to);
+    static esp_err_t receive_body(httpd_req_t *req, std::string &body, size_t max_length);
 };
@@ -2,6 +2,8 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_http_server.h"
+#include "cJSON.h"
+#include "soc/soc_caps.h"
 #include <sstream>
 #include <cstring>
 #include <cassert>
@@ -23,6 +25,17 @@ static esp_err_t sunrise_post_handler(httpd_req_t *req) { return s_instance ? s_
 static esp_err_t settings_post_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_low_level_settings_post(req) : ESP_FAIL; }
 static esp_err_t settings_get_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_low_level_settings_get(req) : ESP_FAIL; }
 static esp_err_t static_get_handler(httpd_req_t *req) { return s_instance ? s_instance->serve_static(req) : ESP_FAIL; }
+static esp_err_t timeline_get_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_timeline_get(req) : ESP_FAIL; }
+static esp_err_t timeline_post_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_timeline_post(req) : ESP_FAIL; }
+static esp_err_t calibration_get_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_calibration_get(req) : ESP_FAIL; }
+static esp_err_t calibration_post_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_calibration_post(req) : ESP_FAIL; }
+static esp_err_t calibration_delete_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_calibration_delete(req) : ESP_FAIL; }
+static esp_err_t alarms_get_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_alarms_get(req) : ESP_FAIL; }
+static esp_err_t alarms_post_handler(httpd_req_t *req) { return s_instance ? s_instance->handle_alarms_post(req) : ESP_FAIL; }
+
+static const char *const EASING_NAMES[] = {"linear", "in", "out", "in_out"};
+// Indexed by tm_wday, bit n of AlarmEntry::weekdays
+static const char *const WEEKDAY_NAMES[] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
 
 std::string WebServer::replace_all(std::string str, const std::string &from, const std::string &to)
 {
@@ -35,8 +48,36 @@ std::string WebServer::replace_all(std::string str, const std::string &from, con
     return str;
 }
 
+esp_err_t WebServer::receive_body(httpd_req_t *req, std::string &body, size_t max_length)
+{
+    size_t content_length = req->content_len;
+    if (content_length == 0 || content_length > max_length)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad Request: invalid content length");
+        return ESP_FAIL;
+    }
+
+    body.clear();
+    body.reserve(content_length);
+    char buf[512];
+    size_t received = 0;
+    while (received < content_length)
+    {
+        size_t to_read = std::min(sizeof(buf), content_length - received);
+        int ret = httpd_req_recv(req, buf, to_read);
+        if (ret <= 0)
+        {
+            httpd_resp_send_500(req);
+            return ESP_FAIL;
+        }
+        body.append(buf, ret);
+        received += ret;
+    }
+    return ESP_OK;
+}
+
 WebServer::WebServer(uint16_t port)
-    : port_(port), settings_(), settings_mutex_(nullptr), server_(nullptr)
+    : port_(port), settings_(Settings::get().getSunrise()), settings_mutex_(nullptr), server_(nullptr)
 {
     settings_mutex_ = xSemaphoreCreateMutex();
     assert(settings_mutex_ != nullptr);
@@ -53,13 +94,7 @@ WebServer::~WebServer()
 
 SunriseSettings WebServer::get_settings_copy() const
 {
-    SunriseSettings copy;
-    if (xSemaphoreTake(settings_mutex_, pdMS_TO_TICKS(10)) == pdTRUE)
-    {
-        copy = settings_;
-        xSemaphoreGive(settings_mutex_);
-    }
-    return copy;
+    return settings_.load();
 }
 
 std::string WebServer::build_html_with_settings(const SunriseSettings &settings)
@@ -77,6 +112,14 @@ std::string WebServer::build_html_with_settings(const SunriseSettings &settings)
     html = replace_all(html, "%ENABLED%", settings.alarm_enabled ? "checked" : "");
     html = replace_all(html, "%LIGHT_PREVIEW%", settings.light_preview ? "checked" : "");
     html = replace_all(html, "%DISABLE_SETTINGS%", settings.disable_hardware_switches ? "checked" : "");
+    html = replace_all(html, "%MODE_COLOR%", settings.sunrise_mode == SUNRISE_MODE_COLOR ? "selected" : "");
+    html = replace_all(html, "%MODE_KELVIN%", settings.sunrise_mode == SUNRISE_MODE_KELVIN ? "selected" : "");
+    html = replace_all(html, "%MODE_TIMELINE%", settings.sunrise_mode == SUNRISE_MODE_TIMELINE ? "selected" : "");
+    html = replace_all(html, "%SPATIAL_UNIFORM%", settings.spatial_mode == SPATIAL_UNIFORM ? "selected" : "");
+    html = replace_all(html, "%SPATIAL_FROM_END%", settings.spatial_mode == SPATIAL_FROM_END ? "selected" : "");
+    html = replace_all(html, "%SPATIAL_FROM_CENTER%", settings.spatial_mode == SPATIAL_FROM_CENTER ? "selected" : "");
+    html = replace_all(html, "%KELVIN_START%", std::to_string(settings.kelvin_start));
+    html = replace_all(html, "%KELVIN_END%", std::to_string(settings.kelvin_end));
     return html;
 }
 
@@ -93,7 +136,19 @@ std::string WebServer::build_low_level_settings_html(const LowLevelSettings &s)
     html = replace_all(html, "%REFRESH_TIME%", std::to_string(s.refresh_time));
     html = replace_all(html, "%CYCLE_SLEEP%", std::to_string(s.cycle_sleep));
 
+    // TZ names may be quoted like <+03>
+    std::string timezone = replace_all(replace_all(Settings::get().getTimezone(), "<", "&lt;"), ">", "&gt;");
+    html = replace_all(html, "%TIMEZONE%", timezone);
+    html = replace_all(html, "%LED_OUTPUTS%", std::to_string(s.led_outputs));
+    html = replace_all(html, "%BACKEND_RMT%", s.led_backend == 0 ? "selected" : "");
+    html = replace_all(html, "%BACKEND_RMT_DMA%", s.led_backend == 1 ? "selected" : "");
+    html = replace_all(html, "%BACKEND_SPI_DMA%", s.led_backend == 2 ? "selected" : "");
+    html = replace_all(html, "%SYMBOL_CACHE_OFF%", s.symbol_cache ? "" : "selected");
+    html = replace_all(html, "%SYMBOL_CACHE_ON%", s.symbol_cache ? "selected" : "");
     html = replace_all(html, "%PIN_LED_OPTIONS%", generate_gpio_options(s.pin_led));
+    html = replace_all(html, "%PIN_LED_2_OPTIONS%", generate_gpio_options(s.pin_led_2));
+    html = replace_all(html, "%PIN_LED_3_OPTIONS%", generate_gpio_options(s.pin_led_3));
+    html = replace_all(html, "%PIN_LED_4_OPTIONS%", generate_gpio_options(s.pin_led_4));
     html = replace_all(html, "%PIN_ALARM_OPTIONS%", generate_gpio_options(s.pin_alarm_switch));
     html = replace_all(html, "%PIN_LIGHT_OPTIONS%", generate_gpio_options(s.pin_light_switch));
 
@@ -160,7 +215,11 @@ esp_err_t WebServer::handle_sunrise_get(httpd_req_t *req)
          << "\"alarm_minute\":" << settings.alarm_minute << ","
          << "\"enabled\":" << (settings.alarm_enabled ? "true" : "false") << ","
          << "\"light_preview\":" << (settings.light_preview ? "true" : "false") << ","
-         << "\"disable_hardware_switches\":" << (settings.disable_hardware_switches ? "true" : "false")
+         << "\"disable_hardware_switches\":" << (settings.disable_hardware_switches ? "true" : "false") << ","
+         << "\"sunrise_mode\":" << settings.sunrise_mode << ","
+         << "\"kelvin_start\":" << settings.kelvin_start << ","
+         << "\"kelvin_end\":" << settings.kelvin_end << ","
+         << "\"spatial_mode\":" << settings.spatial_mode
          << "}";
     httpd_resp_set_type(req, "application/json");
     std::string response = json.str();
@@ -170,32 +229,9 @@ esp_err_t WebServer::handle_sunrise_get(httpd_req_t *req)
 
 esp_err_t WebServer::handle_sunrise_post(httpd_req_t *req)
 {
-    size_t content_length = req->content_len;
-    if (content_length == 0 || content_length > 4096)
-    {
-        ESP_LOGW(TAG, "Invalid Content-Length");
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad Request");
-        return ESP_FAIL;
-    }
-
     std::string body;
-    body.reserve(content_length);
-    char buf[512];
-    size_t received = 0;
-
-    while (received < content_length)
-    {
-        size_t buffer_size = static_cast<size_t>(sizeof(buf));
-        size_t to_read = std::min(buffer_size, content_length - received);
-        int ret = httpd_req_recv(req, buf, to_read);
-        if (ret <= 0)
-        {
-            httpd_resp_send_500(req);
-            return ESP_FAIL;
-        }
-        body.append(buf, ret);
-        received += ret;
-    }
+    if (receive_body(req, body, 4096) != ESP_OK)
+        return ESP_FAIL;
 
     auto url_decode_value = [](const std::string &encoded)
     {
@@ -267,6 +303,14 @@ esp_err_t WebServer::handle_sunrise_post(httpd_req_t *req)
                 settings.alarm_hour = safe_stoi(value, settings.alarm_hour, 0, 23);
             else if (key == "alarm_minute")
                 settings.alarm_minute = safe_stoi(value, settings.alarm_minute, 0, 59);
+            else if (key == "sunrise_mode")
+                settings.sunrise_mode = safe_stoi(value, settings.sunrise_mode, SUNRISE_MODE_COLOR, SUNRISE_MODE_TIMELINE);
+            else if (key == "spatial_mode")
+                settings.spatial_mode = safe_stoi(value, settings.spatial_mode, SPATIAL_UNIFORM, SPATIAL_FROM_CENTER);
+            else if (key == "kelvin_start")
+                settings.kelvin_start = safe_stoi(value, settings.kelvin_start, 1000, 12000);
+            else if (key == "kelvin_end")
+                settings.kelvin_end = safe_stoi(value, settings.kelvin_end, 1000, 12000);
             else if (key == "enabled")
                 new_enabled = (value == "1");
             else if (key == "light_preview")
@@ -280,11 +324,16 @@ esp_err_t WebServer::handle_sunrise_post(httpd_req_t *req)
         settings.disable_hardware_switches = new_disable_hardware_switches;
     };
 
-    if (xSemaphoreTake(settings_mutex_, pdMS_TO_TICKS(50)) == pdTRUE)
+    SunriseSettings saved;
+    update_settings([&](SunriseSettings &settings)
     {
-        parse_params(body, settings_);
-        xSemaphoreGive(settings_mutex_);
-    }
+        parse_params(body, settings);
+        saved = settings;
+        return true;
+    });
+    // Coalesced by the settings writer, the UI posts on every slider change
+    Settings::get().requestSunriseSave(saved);
+    notify_change();
 
     httpd_resp_set_status(req, "303 See Other");
     httpd_resp_set_hdr(req, "Location", "/");
@@ -312,15 +361,42 @@ esp_err_t WebServer::register_uri_handlers()
     httpd_uri_t low_level_post = {"/settings", HTTP_POST, settings_post_handler, nullptr};
     httpd_register_uri_handler(server_, &low_level_post);
 
+    httpd_uri_t timeline_get = {"/timeline", HTTP_GET, timeline_get_handler, nullptr};
+    httpd_register_uri_handler(server_, &timeline_get);
+
+    httpd_uri_t timeline_post = {"/timeline", HTTP_POST, timeline_post_handler, nullptr};
+    httpd_register_uri_handler(server_, &timeline_post);
+
+    httpd_uri_t calibration_get = {"/calibration", HTTP_GET, calibration_get_handler, nullptr};
+    httpd_register_uri_handler(server_, &calibration_get);
+
+    httpd_uri_t calibration_post = {"/calibration", HTTP_POST, calibration_post_handler, nullptr};
+    httpd_register_uri_handler(server_, &calibration_post);
+
+    httpd_uri_t calibration_delete = {"/calibration", HTTP_DELETE, calibration_delete_handler, nullptr};
+    httpd_register_uri_handler(server_, &calibration_delete);
+
+    httpd_uri_t alarms_get = {"/alarms", HTTP_GET, alarms_get_handler, nullptr};
+    httpd_register_uri_handler(server_, &alarms_get);
+
+    httpd_uri_t alarms_post = {"/alarms", HTTP_POST, alarms_post_handler, nullptr};
+    httpd_register_uri_handler(server_, &alarms_post);
+
     return ESP_OK;
 }
 
-esp_err_t WebServer::start()
+esp_err_t WebServer::start(BaseType_t core, unsigned priority, size_t stack_size)
 {
     s_instance = this;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = port_;
-    config.stack_size = 8192;
+    config.core_id = core;
+    config.task_priority = priority;
+    config.stack_size = stack_size;
+    core_ = core;
+    priority_ = priority;
+    stack_size_ = stack_size;
+    config.max_uri_handlers = 16;
 
     if (httpd_start(&server_, &config) != ESP_OK)
         return ESP_FAIL;
@@ -337,46 +413,87 @@ esp_err_t WebServer::stop()
     return ESP_OK;
 }
 
+esp_err_t WebServer::restart(uint16_t port)
+{
+    if (port == port_)
+        return ESP_OK;
+    port_ = port;
+    if (!server_)
+        return ESP_OK;
+
+    // httpd_stop waits until the running handler has returned and closes the sockets
+    stop();
+    esp_err_t err = start(core_, priority_, stack_size_);
+    ESP_LOGI("WebServer", "Webserver auf Port %u neu gestartet: %s", port_, esp_err_to_name(err));
+    return err;
+}
+
+void WebServer::notify_change()
+{
+    if (change_callback_)
+        change_callback_();
+}
+
+bool WebServer::update_settings(const std::function<bool(SunriseSettings &)> &change)
+{
+    // Writers are serialized here; readers only load the snapshot and never block
+    xSemaphoreTake(settings_mutex_, portMAX_DELAY);
+    SunriseSettings settings = settings_.load();
+    bool changed = change(settings);
+    if (changed)
+        settings_.store(settings);
+    xSemaphoreGive(settings_mutex_);
+    return changed;
+}
+
 void WebServer::set_alarm_enabled(bool enabled)
 {
-    if (xSemaphoreTake(settings_mutex_, pdMS_TO_TICKS(10)) == pdTRUE)
+    // Nothing to do in the common case, decided without the mutex
+    SunriseSettings current = settings_.load();
+    if (current.disable_hardware_switches || current.alarm_enabled == enabled)
+        return;
+
+    SunriseSettings saved;
+    bool changed = update_settings([&](SunriseSettings &settings)
+    {
+        if (settings.disable_hardware_switches || settings.alarm_enabled == enabled)
+            return false;
+        settings.alarm_enabled = enabled;
+        saved = settings;
+        return true;
+    });
+    if (changed)
     {
-        if (!settings_.disable_hardware_switches)
-            settings_.alarm_enabled = enabled;
-        xSemaphoreGive(settings_mutex_);
+        Settings::get().requestSunriseSave(saved);
+        notify_change();
     }
 }
 
 bool WebServer::get_alarm_enabled() const
 {
-    bool enabled = false;
-    if (xSemaphoreTake(settings_mutex_, pdMS_TO_TICKS(10)) == pdTRUE)
-    {
-        enabled = settings_.alarm_enabled;
-        xSemaphoreGive(settings_mutex_);
-    }
-    return enabled;
+    return settings_.load().alarm_enabled;
 }
 
 void WebServer::set_light_preview(bool enabled)
 {
-    if (xSemaphoreTake(settings_mutex_, pdMS_TO_TICKS(10)) == pdTRUE)
+    SunriseSettings current = settings_.load();
+    if (current.disable_hardware_switches || current.light_preview == enabled)
+        return;
+
+    bool changed = update_settings([&](SunriseSettings &settings)
     {
-        if (!settings_.disable_hardware_switches)
-            settings_.light_preview = enabled;
-        xSemaphoreGive(settings_mutex_);
-    }
+        if (settings.disable_hardware_switches || settings.light_preview == enabled)
+            return false;
+        settings.light_preview = enabled;
+        return true;
+    });
+    if (changed)
+        notify_change();
 }
 
 bool WebServer::get_light_preview() const
 {
-    bool light_preview = false;
-    if (xSemaphoreTake(settings_mutex_, pdMS_TO_TICKS(10)) == pdTRUE)
-    {
-        light_preview = settings_.light_preview;
-        xSemaphoreGive(settings_mutex_);
-    }
-    return light_preview;
+    return settings_.load().light_preview;
 }
 
 esp_err_t WebServer::handle_low_level_settings_get(httpd_req_t *req)
@@ -390,29 +507,9 @@ esp_err_t WebServer::handle_low_level_settings_get(httpd_req_t *req)
 
 esp_err_t WebServer::handle_low_level_settings_post(httpd_req_t *req)
 {
-    size_t content_length = req->content_len;
-    if (content_length == 0 || content_length > 4096)
-    {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad Request: invalid content length");
-        return ESP_FAIL;
-    }
-
     std::string body;
-    char buf[512];
-    size_t received = 0;
-    while (received < content_length)
-    {
-        size_t buffer_size = static_cast<size_t>(sizeof(buf));
-        size_t to_read = std::min(buffer_size, content_length - received);
-        int ret = httpd_req_recv(req, buf, to_read);
-        if (ret <= 0)
-        {
-            httpd_resp_send_500(req);
-            return ESP_FAIL;
-        }
-        body.append(buf, ret);
-        received += ret;
-    }
+    if (receive_body(req, body, 4096) != ESP_OK)
+        return ESP_FAIL;
 
     // URL-Decoding-Hilfsfunktion
     auto url_decode = [](const std::string& encoded) -> std::string {
@@ -457,7 +554,16 @@ esp_err_t WebServer::handle_low_level_settings_post(httpd_req_t *req)
         return true;
     };
 
+    // LED-Ausgänge brauchen einen Pin, der treiben kann (ESP32: 34–39 sind nur Eingänge)
+    auto is_valid_output_gpio = [&is_valid_gpio](int pin) -> bool {
+        return is_valid_gpio(pin) && ((1ULL << pin) & SOC_GPIO_VALID_OUTPUT_GPIO_MASK) != 0;
+    };
+
+    // Jeder Ausgang kann im schlimmsten Fall auf einen eigenen RMT-Kanal zurückfallen
+    constexpr int max_led_outputs = std::min(4, SOC_RMT_TX_CANDIDATES_PER_GROUP);
+
     LowLevelSettings new_settings = Settings::get().getSettings();
+    std::string timezone;
 
     std::istringstream ss(body);
     std::string pair;
@@ -485,10 +591,36 @@ esp_err_t WebServer::handle_low_level_settings_post(httpd_req_t *req)
             new_settings.port = static_cast<uint16_t>(safe_stoi(value, new_settings.port, 1, 65535));
         else if (key == "pin_led") {
             int pin_val = safe_stoi(value, static_cast<int>(new_settings.pin_led), 0, 39);
-            if (is_valid_gpio(pin_val)) {
+            if (is_valid_output_gpio(pin_val)) {
                 new_settings.pin_led = static_cast<gpio_num_t>(pin_val);
             }
         }
+        else if (key == "timezone")
+            timezone = value;
+        else if (key == "led_backend")
+            new_settings.led_backend = static_cast<uint8_t>(safe_stoi(value, new_settings.led_backend, 0, 2));
+        else if (key == "symbol_cache")
+            new_settings.symbol_cache = static_cast<uint8_t>(safe_stoi(value, new_settings.symbol_cache, 0, 1));
+        else if (key == "led_outputs")
+            new_settings.led_outputs = static_cast<uint8_t>(safe_stoi(value, new_settings.led_outputs, 1, max_led_outputs));
+        else if (key == "pin_led_2") {
+            int pin_val = safe_stoi(value, static_cast<int>(new_settings.pin_led_2), 0, 39);
+            if (is_valid_output_gpio(pin_val)) {
+                new_settings.pin_led_2 = static_cast<gpio_num_t>(pin_val);
+            }
+        }
+        else if (key == "pin_led_3") {
+            int pin_val = safe_stoi(value, static_cast<int>(new_settings.pin_led_3), 0, 39);
+            if (is_valid_output_gpio(pin_val)) {
+                new_settings.pin_led_3 = static_cast<gpio_num_t>(pin_val);
+            }
+        }
+        else if (key == "pin_led_4") {
+            int pin_val = safe_stoi(value, static_cast<int>(new_settings.pin_led_4), 0, 39);
+            if (is_valid_output_gpio(pin_val)) {
+                new_settings.pin_led_4 = static_cast<gpio_num_t>(pin_val);
+            }
+        }
         else if (key == "pin_alarm_switch") {
             int pin_val = safe_stoi(value, static_cast<int>(new_settings.pin_alarm_switch), 0, 39);
             if (is_valid_gpio(pin_val)) {
@@ -503,21 +635,331 @@ esp_err_t WebServer::handle_low_level_settings_post(httpd_req_t *req)
         }
     }
 
+    // Ein Pin darf nur einmal belegt sein, sonst lehnt der Treiber die Ausgänge ab
+    const gpio_num_t led_pins[] = {new_settings.pin_led, new_settings.pin_led_2, new_settings.pin_led_3,
+                                   new_settings.pin_led_4};
+    const int led_outputs = std::clamp<int>(new_settings.led_outputs, 1, max_led_outputs);
+    new_settings.led_outputs = static_cast<uint8_t>(led_outputs);
+    for (int i = 0; i < led_outputs; i++)
+    {
+        bool duplicate = led_pins[i] == new_settings.pin_alarm_switch || led_pins[i] == new_settings.pin_light_switch;
+        for (int j = 0; j < i; j++)
+            duplicate |= led_pins[i] == led_pins[j];
+        if (duplicate)
+        {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "LED-Pins doppelt belegt");
+            return ESP_FAIL;
+        }
+    }
+
+    // Erst alles prüfen, damit ein abgelehntes Formular nichts halb speichert
+    if (!timezone.empty() && !Settings::isValidTimezone(timezone))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Ungültige Zeitzone");
+        return ESP_FAIL;
+    }
+
+    const uint16_t old_port = Settings::get().getSettings().port;
     esp_err_t err = Settings::get().setSettings(new_settings);
     if (err != ESP_OK)
     {
         ESP_LOGE("WebServer", "Fehler beim Speichern der Low-Level-Settings: %s", esp_err_to_name(err));
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Fehler beim Speichern der Einstellungen");
+        // Schlägt nur das Schreiben in den Flash fehl, gelten die Werte trotzdem schon
+        notify_change();
         return ESP_FAIL;
     }
 
-    // Erfolgsnachricht
+    // Die Zeitzone gilt sofort, ohne Neustart
+    if (!timezone.empty() && timezone != Settings::get().getTimezone())
+    {
+        err = Settings::get().setTimezone(timezone);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE("WebServer", "Fehler beim Speichern der Zeitzone: %s", esp_err_to_name(err));
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Fehler beim Speichern der Zeitzone");
+            // Die übrigen Einstellungen sind bereits gespeichert
+            notify_change();
+            return ESP_FAIL;
+        }
+    }
+
+    // Erfolgsnachricht; die Änderungen gelten ohne Neustart
+    std::string link = "/";
+    std::string note = "Die Änderungen sind sofort aktiv.";
+    if (new_settings.port != old_port)
+    {
+        char host[64] = {};
+        httpd_req_get_hdr_value_str(req, "Host", host, sizeof(host));
+        std::string hostname(host);
+        size_t colon = hostname.find(':');
+        if (colon != std::string::npos)
+            hostname.erase(colon);
+        link = "http://" + hostname + ":" + std::to_string(new_settings.port) + "/";
+        note = "Der Webserver ist ab sofort auf Port " + std::to_string(new_settings.port) + " erreichbar.";
+    }
     std::string msg = "<html><head><meta charset='UTF-8'></head><body>"
                       "<h3>✅ Einstellungen gespeichert!</h3>"
-                      "<p>Neustart erforderlich, damit die Änderungen wirksam werden.</p>"
-                      "<a href='/'>Zurück zur Startseite</a></body></html>";
+                      "<p>" + note + "</p>"
+                      "<a href='" + link + "'>Zurück zur Startseite</a></body></html>";
     httpd_resp_set_type(req, "text/html; charset=utf-8");
     httpd_resp_send(req, msg.c_str(), msg.length());
 
+    // Erst nach der Antwort, ein Portwechsel startet den Server neu
+    notify_change();
+    return ESP_OK;
+}
+
+esp_err_t WebServer::handle_timeline_get(httpd_req_t *req)
+{
+    std::vector<Keyframe> timeline = Settings::get().getTimeline();
+    std::ostringstream json;
+    json << "{\"keyframes\":[";
+    for (size_t i = 0; i < timeline.size(); i++)
+    {
+        const Keyframe &k = timeline[i];
+        json << (i ? "," : "") << "{"
+             << "\"at\":" << k.at << ","
+             << "\"red\":" << int(k.red) << ","
+             << "\"green\":" << int(k.green) << ","
+             << "\"blue\":" << int(k.blue) << ","
+             << "\"brightness\":" << int(k.brightness) << ","
+             << "\"easing\":\"" << EASING_NAMES[k.easing <= EASING_IN_OUT ? k.easing : 0] << "\""
+             << "}";
+    }
+    json << "]}";
+
+    httpd_resp_set_type(req, "application/json");
+    std::string response = json.str();
+    httpd_resp_send(req, response.c_str(), response.length());
+    return ESP_OK;
+}
+
+esp_err_t WebServer::handle_timeline_post(httpd_req_t *req)
+{
+    std::string body;
+    if (receive_body(req, body, 4096) != ESP_OK)
+        return ESP_FAIL;
+
+    cJSON *root = cJSON_ParseWithLength(body.c_str(), body.length());
+    const cJSON *keyframes = root ? cJSON_GetObjectItemCaseSensitive(root, "keyframes") : nullptr;
+    if (!cJSON_IsArray(keyframes))
+    {
+        cJSON_Delete(root);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected {\"keyframes\":[...]}");
+        return ESP_FAIL;
+    }
+
+    auto get_int = [](const cJSON *item, const char *name, int def, int min_val, int max_val)
+    {
+        const cJSON *value = cJSON_GetObjectItemCaseSensitive(item, name);
+        if (!cJSON_IsNumber(value))
+            return def;
+        return std::clamp(value->valueint, min_val, max_val);
+    };
+
+    std::vector<Keyframe> timeline;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, keyframes)
+    {
+        if (!cJSON_IsObject(item) || timeline.size() >= MAX_KEYFRAMES)
+            continue;
+
+        Keyframe k;
+        k.at = static_cast<uint16_t>(get_int(item, "at", 0, 0, 1000));
+        k.red = static_cast<uint8_t>(get_int(item, "red", 0, 0, 255));
+        k.green = static_cast<uint8_t>(get_int(item, "green", 0, 0, 255));
+        k.blue = static_cast<uint8_t>(get_int(item, "blue", 0, 0, 255));
+        k.brightness = static_cast<uint8_t>(get_int(item, "brightness", 255, 0, 255));
+
+        const cJSON *easing = cJSON_GetObjectItemCaseSensitive(item, "easing");
+        if (cJSON_IsString(easing))
+        {
+            for (uint8_t e = EASING_LINEAR; e <= EASING_IN_OUT; e++)
+            {
+                if (strcmp(easing->valuestring, EASING_NAMES[e]) == 0)
+                    k.easing = e;
+            }
+        }
+        timeline.push_back(k);
+    }
+    cJSON_Delete(root);
+
+    std::stable_sort(timeline.begin(), timeline.end(), [](const Keyframe &a, const Keyframe &b) { return a.at < b.at; });
+
+    esp_err_t err = Settings::get().setTimeline(timeline);
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Timeline needs 2 to 16 keyframes");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Fehler beim Speichern der Timeline: %s", esp_err_to_name(err));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Fehler beim Speichern der Timeline");
+        return ESP_FAIL;
+    }
+
+    notify_change();
+    return handle_timeline_get(req);
+}
+
+// Weekly alarms; sunrise_mode and spatial_mode -1 follow the sunrise settings
+esp_err_t WebServer::handle_alarms_get(httpd_req_t *req)
+{
+    std::vector<AlarmEntry> alarms = Settings::get().getAlarms();
+    auto profile = [](uint8_t value) { return value == ALARM_PROFILE_DEFAULT ? -1 : int(value); };
+
+    std::ostringstream json;
+    json << "{\"alarms\":[";
+    for (size_t i = 0; i < alarms.size(); i++)
+    {
+        const AlarmEntry &a = alarms[i];
+        json << (i ? "," : "") << "{"
+             << "\"hour\":" << int(a.hour) << ","
+             << "\"minute\":" << int(a.minute) << ","
+             << "\"weekdays\":[";
+        bool first = true;
+        for (int day = 0; day < 7; day++)
+        {
+            if (!(a.weekdays & (1 << day)))
+                continue;
+            json << (first ? "" : ",") << "\"" << WEEKDAY_NAMES[day] << "\"";
+            first = false;
+        }
+        json << "],"
+             << "\"enabled\":" << (a.enabled ? "true" : "false") << ","
+             << "\"duration_minutes\":" << int(a.duration_minutes) << ","
+             << "\"duration_on_brightest\":" << int(a.duration_on_brightest) << ","
+             << "\"sunrise_mode\":" << profile(a.sunrise_mode) << ","
+             << "\"spatial_mode\":" << profile(a.spatial_mode)
+             << "}";
+    }
+    json << "]}";
+
+    httpd_resp_set_type(req, "application/json");
+    std::string response = json.str();
+    httpd_resp_send(req, response.c_str(), response.length());
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+esp_err_t WebServer::handle_alarms_post(httpd_req_t *req)
+{
+    std::string body;
+    if (receive_body(req, body, 8192) != ESP_OK)
+        return ESP_FAIL;
+
+    cJSON *root = cJSON_ParseWithLength(body.c_str(), body.length());
+    const cJSON *list = root ? cJSON_GetObjectItemCaseSensitive(root, "alarms") : nullptr;
+    if (!cJSON_IsArray(list) || static_cast<size_t>(cJSON_GetArraySize(list)) > MAX_ALARMS)
+    {
+        cJSON_Delete(root);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected {\"alarms\":[...]} with at most 32 alarms");
+        return ESP_FAIL;
+    }
+
+    auto get_int = [](const cJSON *item, const char *name, int def, int min_val, int max_val)
+    {
+        const cJSON *value = cJSON_GetObjectItemCaseSensitive(item, name);
+        if (!cJSON_IsNumber(value))
+            return def;
+        return std::clamp(value->valueint, min_val, max_val);
+    };
+    auto get_profile = [&](const cJSON *item, const char *name, int max_val)
+    {
+        int value = get_int(item, name, -1, -1, max_val);
+        return static_cast<uint8_t>(value < 0 ? ALARM_PROFILE_DEFAULT : value);
+    };
+
+    std::vector<AlarmEntry> alarms;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, list)
+    {
+        if (!cJSON_IsObject(item))
+            continue;
+
+        AlarmEntry a;
+        a.hour = static_cast<uint8_t>(get_int(item, "hour", a.hour, 0, 23));
+        a.minute = static_cast<uint8_t>(get_int(item, "minute", a.minute, 0, 59));
+        a.duration_minutes = static_cast<uint8_t>(get_int(item, "duration_minutes", a.duration_minutes, 1, 120));
+        a.duration_on_brightest = static_cast<uint8_t>(get_int(item, "duration_on_brightest", a.duration_on_brightest, 1, 120));
+        a.sunrise_mode = get_profile(item, "sunrise_mode", SUNRISE_MODE_TIMELINE);
+        a.spatial_mode = get_profile(item, "spatial_mode", SPATIAL_FROM_CENTER);
+
+        const cJSON *enabled = cJSON_GetObjectItemCaseSensitive(item, "enabled");
+        if (cJSON_IsBool(enabled))
+            a.enabled = cJSON_IsTrue(enabled);
+
+        const cJSON *weekdays = cJSON_GetObjectItemCaseSensitive(item, "weekdays");
+        if (cJSON_IsArray(weekdays))
+        {
+            a.weekdays = 0;
+            const cJSON *day;
+            cJSON_ArrayForEach(day, weekdays)
+            {
+                for (int d = 0; d < 7; d++)
+                {
+                    if (cJSON_IsString(day) && strcmp(day->valuestring, WEEKDAY_NAMES[d]) == 0)
+                        a.weekdays |= 1 << d;
+                }
+            }
+        }
+        alarms.push_back(a);
+    }
+    cJSON_Delete(root);
+
+    esp_err_t err = Settings::get().setAlarms(alarms);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Fehler beim Speichern der Wecker: %s", esp_err_to_name(err));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Fehler beim Speichern der Wecker");
+        return ESP_FAIL;
+    }
+
+    notify_change();
+    return handle_alarms_get(req);
+}
+
+// Calibration table as a binary blob: r, g, b gain bytes per entry, 255 = unchanged
+esp_err_t WebServer::handle_calibration_get(httpd_req_t *req)
+{
+    std::vector<uint8_t> calibration = Settings::get().getCalibration();
+    httpd_resp_set_type(req, "application/octet-stream");
+    return httpd_resp_send(req, reinterpret_cast<const char *>(calibration.data()), calibration.size());
+}
+
+esp_err_t WebServer::handle_calibration_post(httpd_req_t *req)
+{
+    std::string body;
+    if (receive_body(req, body, MAX_CALIBRATION_ENTRIES * 3) != ESP_OK)
+        return ESP_FAIL;
+    if (body.size() % 3 != 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected r, g, b bytes per entry");
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = Settings::get().setCalibration(std::vector<uint8_t>(body.begin(), body.end()));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Fehler beim Speichern der Kalibrierung: %s", esp_err_to_name(err));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Fehler beim Speichern der Kalibrierung");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Kalibrierung mit %u Einträgen gespeichert", static_cast<unsigned>(body.size() / 3));
+    notify_change();
+    return httpd_resp_sendstr(req, "OK");
+}
+
+esp_err_t WebServer::handle_calibration_delete(httpd_req_t *req)
+{
+    esp_err_t err = Settings::get().setCalibration({});
+    if (err != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Fehler beim Löschen der Kalibrierung");
+        return ESP_FAIL;
+    }
+    notify_change();
+    return httpd_resp_sendstr(req, "OK");
+}
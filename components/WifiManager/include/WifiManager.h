@@ -5,7 +5,8 @@
 
 class WiFiManager {
 public:
-    void init();
+    // Starts connecting and returns; callback runs in the event task on every new IP
+    void init(void (*on_connected)() = nullptr);
     esp_err_t connect();
     bool is_connected();
 };
@@ -7,6 +7,7 @@
 
 static const char *TAG = "WiFiManager";
 static bool s_connected = false;
+static void (*s_on_connected)() = nullptr;
 
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
@@ -27,11 +28,15 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
     {
         ESP_LOGI(TAG, "Got IP address");
         s_connected = true;
+        if (s_on_connected)
+            s_on_connected();
     }
 }
 
-void WiFiManager::init()
+void WiFiManager::init(void (*on_connected)())
 {
+    s_on_connected = on_connected;
+
     // Initialize TCP/IP network interface (required)
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -67,6 +72,9 @@ void WiFiManager::init()
 
     // Start Wi-Fi (triggers WIFI_EVENT_STA_START)
     ESP_ERROR_CHECK(esp_wifi_start());
+
+    // Modem sleep between DTIM beacons, required for automatic light sleep
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MIN_MODEM));
 }
 
 bool WiFiManager::is_connected()
@@ -3,36 +3,62 @@
 #include "WiFiManager.h"
 #include "WebServer.h"
 #include "Alarm.h"
+#include "Benchmark.h"
+#include "Renderer.h"
+#include "Power.h"
+#include "Switches.h"
+#include "Boot.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "nvs_flash.h"
+#include <algorithm>
+#include <memory>
 
 static const char *TAG = "Main";
 
-void switch_init(const LowLevelSettings &settings)
+static BaseType_t task_core(int core)
 {
-    gpio_config_t io_conf = {
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE};
-
-    io_conf.pin_bit_mask = 1ULL << settings.pin_alarm_switch; // Beispiel Pin
-    gpio_config(&io_conf);
-
-    io_conf.pin_bit_mask = 1ULL << settings.pin_light_switch;
-    gpio_config(&io_conf);
+#if CONFIG_FREERTOS_UNICORE
+    return tskNO_AFFINITY;
+#else
+    return core;
+#endif
 }
 
-bool initialize_wifi()
+void log_task_stacks()
 {
-    WiFiManager wifiManager;
-    wifiManager.init();
-    while (!wifiManager.is_connected())
+    static const char *const task_names[] = {"main", "render", "httpd", "wifi", "tiT", "esp_timer", "sys_evt", "net_boot", "settings"};
+    for (const char *name : task_names)
     {
-        vTaskDelay(pdMS_TO_TICKS(500));
+        TaskHandle_t task = xTaskGetHandle(name);
+        if (task)
+            ESP_LOGI(TAG, "Stack %-10s %5u bytes never used", name, (unsigned)uxTaskGetStackHighWaterMark(task));
     }
-    return true;
+}
+
+static Renderer *s_renderer = nullptr;
+
+// Network, time and web server come up here while the lamp already runs. Nothing in
+// this task waits for the router: WiFi and SNTP report back through their callbacks.
+static void network_boot_task(void *arg)
+{
+    auto *server = static_cast<WebServer *>(arg);
+
+    WiFiManager wifiManager;
+    wifiManager.init([] { Boot::done(BOOT_NETWORK); });
+    Alarm::init([] {
+        Boot::done(BOOT_TIME);
+        // The clock stepped, re-plan the sunrise now instead of at the next deadline
+        if (s_renderer)
+            s_renderer->wake();
+    });
+
+    if (server->start(task_core(CONFIG_SUNRISE_HTTPD_TASK_CORE), CONFIG_SUNRISE_HTTPD_TASK_PRIORITY,
+                      CONFIG_SUNRISE_HTTPD_TASK_STACK) == ESP_OK)
+        Boot::done(BOOT_HTTP);
+    else
+        ESP_LOGE(TAG, "Web server start failed!");
+    vTaskDelete(nullptr);
 }
 
 extern "C" void app_main(void)
@@ -46,35 +72,137 @@ extern "C" void app_main(void)
     ESP_ERROR_CHECK(ret);
 
     Settings &settings = Settings::get();
-    if (settings.init() != ESP_OK) {
-        ESP_LOGE(TAG, "Settings init failed!");
-        return;
-    }
+    if (settings.init() != ESP_OK)
+        ESP_LOGW(TAG, "Some settings could not be loaded, using their defaults");
+    // Low priority: flash writes stall the cache, they must never delay a frame
+    if (settings.startWriter(task_core(CONFIG_SUNRISE_HTTPD_TASK_CORE), tskIDLE_PRIORITY + 2,
+                             CONFIG_SUNRISE_SAVE_DEBOUNCE_MS, CONFIG_SUNRISE_SAVE_MAX_DELAY_MS) != ESP_OK)
+        ESP_LOGW(TAG, "Settings writer failed, saving synchronously");
+    Boot::done(BOOT_SETTINGS);
 
     LowLevelSettings low_level_settings = Settings::get().getSettings();
 
-    LEDStrip strip(low_level_settings.pin_led, low_level_settings.num_leds, false);
+#if CONFIG_SUNRISE_POWER_SAVE
+    Power::init(CONFIG_SUNRISE_MIN_CPU_FREQ_MHZ, true);
+#endif
+
+#if CONFIG_SUNRISE_BENCHMARK
+    Benchmark::run(low_level_settings);
+#endif
+
+    // Owned by the renderer, which rebuilds it when the LED settings change
+    std::unique_ptr<LEDStrip> strip = Renderer::create_strip(low_level_settings);
+    if (!strip->ok())
+    {
+        // Stored pins the driver refuses must not keep the device from booting
+        ESP_LOGE(TAG, "LED strip settings rejected by the driver, using the default layout");
+        strip.reset();
+        Renderer::copy_strip_layout(low_level_settings, LowLevelSettings());
+        strip = Renderer::create_strip(low_level_settings);
+    }
+    Boot::done(BOOT_STRIP);
 
-    initialize_wifi();
-    Alarm::init();
+    // Holds the sunrise settings; the HTTP server itself starts with the network
     WebServer server(low_level_settings.port);
-    if (server.start() != ESP_OK)
-        return;
 
-    switch_init(low_level_settings);
+    // The main loop waits for switch events and settings changes through its notification
+    TaskHandle_t main_task = xTaskGetCurrentTaskHandle();
+    auto start_switches = [main_task](const LowLevelSettings &s, bool &interrupts)
+    {
+        auto switches = std::make_unique<Switches>(s.pin_alarm_switch, s.pin_light_switch,
+                                                   CONFIG_SUNRISE_SWITCH_DEBOUNCE_MS, main_task);
+        // Either way the current positions are queued right away
+        interrupts = switches->start() == ESP_OK;
+        if (!interrupts)
+            switches->poll();
+        return switches;
+    };
+    bool switch_interrupts = false;
+    std::unique_ptr<Switches> switches = start_switches(low_level_settings, switch_interrupts);
+    Boot::done(BOOT_SWITCHES);
+
+    Renderer renderer(std::move(strip), server, low_level_settings);
+    if (renderer.start(task_core(CONFIG_SUNRISE_RENDER_TASK_CORE), CONFIG_SUNRISE_RENDER_TASK_PRIORITY,
+                       CONFIG_SUNRISE_RENDER_TASK_STACK) != ESP_OK) {
+        ESP_LOGE(TAG, "Renderer start failed!");
+        return;
+    }
+    // Between sunrise transitions the renderer sleeps; settings changes wake it
+    server.set_change_callback([&renderer, main_task]
+    {
+        renderer.wake();
+        xTaskNotifyGive(main_task);
+    });
+    s_renderer = &renderer;
+    if (renderer.wait_first_frame(pdMS_TO_TICKS(1000)))
+        Boot::done(BOOT_FIRST_LIGHT);
+
+    if (xTaskCreatePinnedToCore(network_boot_task, "net_boot", 4096, &server, CONFIG_SUNRISE_HTTPD_TASK_PRIORITY,
+                                nullptr, task_core(CONFIG_SUNRISE_HTTPD_TASK_CORE)) != pdPASS)
+        ESP_LOGE(TAG, "Network boot task failed!");
     ESP_LOGI(TAG, "Setup finished!");
 
-    // Loop
+    auto apply_switch_events = [&switches, &server, &renderer]
+    {
+        SwitchEvent event;
+        while (switches->receive(event, 0))
+        {
+            ESP_LOGI(TAG, "%s switch is %s", event.id == SWITCH_ALARM ? "alarm" : "light_preview", event.on ? "ON" : "OFF");
+            if (event.id == SWITCH_ALARM)
+                server.set_alarm_enabled(event.on);
+            else
+                server.set_light_preview(event.on);
+            // Measures switch-to-light latency on the frame that picks the change up
+            renderer.wake(event.edge_us);
+        }
+    };
+    // The positions queued at boot, before the loop first waits
+    apply_switch_events();
+
+    // Loop: wakes on a switch event or a settings change, otherwise only for the status
+    // report. Without switch interrupts the switches are polled every cycle_sleep.
+    const TickType_t status_interval = pdMS_TO_TICKS(CONFIG_SUNRISE_STATUS_INTERVAL * 1000);
+    uint32_t low_level_revision = settings.lowLevelRevision();
+    TickType_t last_stack_report = 0;
+    TickType_t last_status = 0;
     while (true)
     {
-        vTaskDelay(pdMS_TO_TICKS(low_level_settings.cycle_sleep));
+        ulTaskNotifyTake(pdTRUE, switch_interrupts ? status_interval : pdMS_TO_TICKS(low_level_settings.cycle_sleep));
+        if (!switch_interrupts)
+            switches->poll();
 
-        int level_alarm = gpio_get_level(low_level_settings.pin_alarm_switch);
-        int level_light_preview = gpio_get_level(low_level_settings.pin_light_switch);
-        ESP_LOGI(TAG, "level_alarm is %s and level_light_preview is %s", level_alarm ? "ON" : "OFF", level_light_preview ? "ON" : "OFF");
+        apply_switch_events();
+
+        // Low-level settings apply live. The renderer picks up the strip, refresh and
+        // colour changes itself; switches and web server belong to this task.
+        uint32_t revision = settings.lowLevelRevision();
+        if (revision != low_level_revision)
+        {
+            low_level_revision = revision;
+            LowLevelSettings updated = settings.getSettings();
+            if (updated.pin_alarm_switch != low_level_settings.pin_alarm_switch ||
+                updated.pin_light_switch != low_level_settings.pin_light_switch)
+            {
+                // The new switches report their current positions once started
+                switches.reset();
+                switches = start_switches(updated, switch_interrupts);
+                apply_switch_events();
+            }
+            if (updated.port != server.port())
+                server.restart(updated.port);
+            low_level_settings = updated;
+        }
 
-        server.set_alarm_enabled(level_alarm == 1);
-        server.set_light_preview(level_light_preview == 1);
+        if (CONFIG_SUNRISE_STACK_REPORT_INTERVAL > 0 &&
+            xTaskGetTickCount() - last_stack_report >= pdMS_TO_TICKS(CONFIG_SUNRISE_STACK_REPORT_INTERVAL * 1000))
+        {
+            last_stack_report = xTaskGetTickCount();
+            log_task_stacks();
+        }
+
+        if (xTaskGetTickCount() - last_status < status_interval)
+            continue;
+        last_status = xTaskGetTickCount();
 
         SunriseSettings sunrise_settings = server.get_settings_copy();
 
@@ -82,35 +210,25 @@ extern "C" void app_main(void)
                  sunrise_settings.red, sunrise_settings.green, sunrise_settings.blue, sunrise_settings.light_preview ? "YES" : "NO", sunrise_settings.duration_minutes,
                  sunrise_settings.duration_on_brightest, sunrise_settings.alarm_hour, sunrise_settings.alarm_minute, sunrise_settings.alarm_enabled ? "YES" : "NO");
 
-        double sunrise_percentage;
-        if (Alarm::is_alarm_time(sunrise_settings, sunrise_percentage))
-        {
-            int red = static_cast<int>(low_level_settings.sunrise_red * sunrise_percentage);
-            int green = static_cast<int>(low_level_settings.sunrise_green * sunrise_percentage);
-            int blue = static_cast<int>(low_level_settings.sunrise_blue * sunrise_percentage);
+        Settings::WriterStats writer = settings.writerStats();
+        ESP_LOGI(TAG, "Settings: %lu saves requested, %lu commits",
+                 (unsigned long)writer.requested, (unsigned long)writer.commits);
 
-            red = std::min(255, std::max(0, red));
-            green = std::min(255, std::max(0, green));
-            blue = std::min(255, std::max(0, blue));
+        RenderStats stats = renderer.stats();
+        ESP_LOGI(TAG, "Render: %lu frames | frame %lu us (max %lu) | jitter %lu us (max %lu) | switch latency %lu us (max %lu) | sent %lu skipped %lu reused %lu | strip rebuilds %lu",
+                 (unsigned long)stats.frames, (unsigned long)stats.frame_time_us, (unsigned long)stats.max_frame_time_us,
+                 (unsigned long)stats.jitter_us, (unsigned long)stats.max_jitter_us,
+                 (unsigned long)stats.input_latency_us, (unsigned long)stats.max_input_latency_us,
+                 (unsigned long)stats.frames_sent, (unsigned long)stats.frames_skipped,
+                 (unsigned long)stats.frames_reused, (unsigned long)stats.strip_rebuilds);
 
-            for (int i = 0; i < low_level_settings.num_leds; i++)
-            {
-                strip.setPixel(i, red, green, blue);
-            }
-            strip.refresh();
-        }
-        else if (sunrise_settings.light_preview)
-        {
-            for (int i = 0; i < low_level_settings.num_leds; i++)
-            {
-                strip.setPixel(i, sunrise_settings.red, sunrise_settings.green, sunrise_settings.blue);
-            }
-            strip.refresh();
-        }
-        else
+        if (Power::light_sleep_enabled())
         {
-            strip.clear();
-            strip.refresh();
+            Power::SleepStats sleep = Power::sleep_stats();
+            uint64_t total_us = sleep.asleep_us + sleep.awake_us;
+            ESP_LOGI(TAG, "Power: asleep %llu s, awake %llu s (%llu%% asleep) | %lu light sleeps",
+                     (unsigned long long)(sleep.asleep_us / 1000000), (unsigned long long)(sleep.awake_us / 1000000),
+                     (unsigned long long)(total_us ? sleep.asleep_us * 100 / total_us : 0), (unsigned long)sleep.sleeps);
         }
     }
 }
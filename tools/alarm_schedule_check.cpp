@@ -0,0 +1,121 @@
+// Host check for the weekly alarm schedule (components/Alarm/src/Schedule.cpp) under
+// Central European time. Steps through 2026 from one sunrise to the next and checks
+// that the schedule head is the earliest occurrence over all alarms computed directly,
+// falls on a weekday of its alarm and starts at the alarm's local time. Only the hour
+// skipped in spring may move a start, by exactly one hour. Exits with 1 if a start time
+// or the number of sunrises is off.
+//
+//   g++ -std=c++20 -O2 -Icomponents/Alarm/include -Icomponents/Settings/include -o alarm_schedule_check
+//       tools/alarm_schedule_check.cpp components/Alarm/src/Schedule.cpp components/Alarm/src/TimeZone.cpp
+//   ./alarm_schedule_check
+#include "Alarm.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+// TZ is fixed in main(), there is no setting to follow
+uint32_t TimeZone::setting_revision()
+{
+    return 0;
+}
+
+void TimeZone::apply_setting()
+{
+}
+
+namespace {
+
+// Local midnight through mktime, the C library reference
+int64_t local_ms(int year, int month, int day)
+{
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_isdst = -1;
+    return static_cast<int64_t>(mktime(&t)) * 1000;
+}
+
+struct tm local_time(int64_t epoch_ms)
+{
+    struct tm t;
+    time_t at = static_cast<time_t>(epoch_ms / 1000);
+    localtime_r(&at, &t);
+    return t;
+}
+
+} // namespace
+
+int main()
+{
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+
+    std::vector<AlarmEntry> alarms(4);
+    alarms[0].hour = 6, alarms[0].minute = 30, alarms[0].weekdays = 0x3E;  // Mon-Fri
+    alarms[1].hour = 2, alarms[1].minute = 30, alarms[1].weekdays = 0x01;  // Sun, inside both DST changes
+    alarms[2].hour = 23, alarms[2].minute = 50, alarms[2].weekdays = 0x7F; // across midnight
+    alarms[2].duration_minutes = 20, alarms[2].duration_on_brightest = 10;
+    alarms[3].hour = 9, alarms[3].minute = 0, alarms[3].weekdays = 0x40;   // Sat
+    alarms[3].duration_minutes = 60, alarms[3].duration_on_brightest = 120;
+
+    const int64_t year_start = local_ms(2026, 1, 1), year_end = local_ms(2027, 1, 1);
+    int expected = 0;
+    for (int day = 1; local_ms(2026, 1, day) < year_end; day++) {
+        struct tm t = local_time(local_ms(2026, 1, day));
+        for (const AlarmEntry &alarm : alarms)
+            expected += (alarm.weekdays >> t.tm_wday) & 1;
+    }
+
+    int fired = 0, errors = 0, shifted = 0;
+    TimeZone zone;
+    Alarm::Schedule schedule;
+    schedule.rebuild(alarms, year_start);
+    for (int64_t now = year_start; !schedule.empty() && schedule.plan().start_ms < year_end;) {
+        const Alarm::SunrisePlan head = schedule.plan();
+        const AlarmEntry &alarm = schedule.alarm();
+
+        int64_t earliest = INT64_MAX;
+        for (const AlarmEntry &entry : alarms) {
+            Alarm::SunrisePlan plan;
+            if (Alarm::next_occurrence(entry, now, plan, zone))
+                earliest = std::min(earliest, plan.start_ms);
+        }
+
+        struct tm t = local_time(head.start_ms);
+        const int minute_of_day = t.tm_hour * 60 + t.tm_min;
+        const int alarm_minute = alarm.hour * 60 + alarm.minute;
+        bool ok = head.start_ms == earliest && ((alarm.weekdays >> t.tm_wday) & 1);
+        ok = ok && head.full_ms == head.start_ms + alarm.duration_minutes * 60 * 1000LL;
+        ok = ok && head.end_ms == head.full_ms + alarm.duration_on_brightest * 60 * 1000LL;
+        if (minute_of_day != alarm_minute) {
+            // The skipped hour: the local time one hour on, on the day summer time starts
+            bool skipped = minute_of_day == alarm_minute + 60 && t.tm_isdst > 0 &&
+                           local_time(head.start_ms - 3600 * 1000LL).tm_isdst == 0;
+            ok = ok && skipped;
+            shifted++;
+        } else if (local_time(head.start_ms - 3600 * 1000LL).tm_hour == t.tm_hour) {
+            // The repeated hour in autumn: the first of the two instants
+            ok = ok && t.tm_isdst > 0;
+        }
+        if (!ok) {
+            printf("WRONG %04d-%02d-%02d %02d:%02d (alarm %02u:%02u, weekdays 0x%02x)\n", t.tm_year + 1900,
+                   t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, alarm.hour, alarm.minute, alarm.weekdays);
+            errors++;
+        }
+        // Not the one from New Year's Eve still running at midnight
+        if (head.start_ms >= year_start)
+            fired++;
+
+        now = head.end_ms;
+        schedule.advance(now);
+    }
+
+    const bool ok = errors == 0 && fired == expected && shifted == 1;
+    printf("Alarm schedule: %d sunrises over 2026 (expected %d), %d wrong, %d moved by DST (expected 1)  %s\n",
+           fired, expected, errors, shifted, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+// Turns an LEDStrip capture (linux target, see components/LEDStrip/include/LEDCapture.h)
+// into per-LED time series.
+//
+//   g++ -std=c++20 -O2 -Icomponents/LEDStrip/include -o ledcap_dump tools/ledcap_dump.cpp
+//   ./ledcap_dump ledstrip.cap              summary
+//   ./ledcap_dump ledstrip.cap 0 40 79      CSV: time_ms, then r,g,b of LEDs 0, 40 and 79
+//   ./ledcap_dump ledstrip.cap all          CSV with every LED
+#include "LEDCapture.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture [all | led...]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    LEDCapture::Header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, LEDCapture::kMagic, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not an LED capture\n", argv[1]);
+        return 1;
+    }
+    const uint32_t count = header.led_count;
+
+    std::vector<uint32_t> leds;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "all") == 0) {
+            for (uint32_t led = 0; led < count; led++)
+                leds.push_back(led);
+            continue;
+        }
+        long led = strtol(argv[i], nullptr, 10);
+        if (led < 0 || static_cast<uint32_t>(led) >= count) {
+            fprintf(stderr, "LED %s out of range (0..%u)\n", argv[i], count - 1);
+            return 2;
+        }
+        leds.push_back(static_cast<uint32_t>(led));
+    }
+
+    if (!leds.empty()) {
+        printf("time_ms");
+        for (uint32_t led : leds)
+            printf(",r%u,g%u,b%u", led, led, led);
+        printf("\n");
+    }
+
+    std::vector<uint8_t> rgb(count * 3);
+    int64_t timestamp, first = 0, last = 0, max_gap = 0;
+    uint64_t frames = 0;
+    while (fread(&timestamp, sizeof(timestamp), 1, file) == 1 && fread(rgb.data(), 1, rgb.size(), file) == rgb.size()) {
+        if (frames == 0)
+            first = timestamp;
+        else if (timestamp - last > max_gap)
+            max_gap = timestamp - last;
+        last = timestamp;
+        frames++;
+
+        if (leds.empty())
+            continue;
+        printf("%.3f", (timestamp - first) / 1000.0);
+        for (uint32_t led : leds)
+            printf(",%u,%u,%u", rgb[led * 3], rgb[led * 3 + 1], rgb[led * 3 + 2]);
+        printf("\n");
+    }
+    fclose(file);
+
+    if (leds.empty()) {
+        double seconds = (last - first) / 1e6;
+        printf("%u LEDs, %llu frames over %.3f s", count, static_cast<unsigned long long>(frames), seconds);
+        if (seconds > 0)
+            printf(", %.1f frames/s, longest gap %.3f ms", (frames - 1) / seconds, max_gap / 1000.0);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Host check for Alarm::sunrise_progress (components/Alarm/src/Schedule.cpp): the Q16
+// progress must be bit-identical to the exact floor of elapsed * 65535 / duration, and
+// clamp to 0 and 65535 outside the window. Exits with 1 on the first mismatch.
+//
+//   g++ -std=c++20 -O2 -Icomponents/Alarm/include -Icomponents/Settings/include -o sunrise_progress_check
+//       tools/sunrise_progress_check.cpp components/Alarm/src/Schedule.cpp components/Alarm/src/TimeZone.cpp
+//   ./sunrise_progress_check
+#include "Alarm.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+// The timezone setting is not used here
+uint32_t TimeZone::setting_revision()
+{
+    return 0;
+}
+
+void TimeZone::apply_setting()
+{
+}
+
+namespace {
+
+uint64_t checked = 0;
+
+// elapsed * 65535 stays below 2^53, so it is exact in a double, and the correctly
+// rounded quotient of two such integers cannot cross an integer
+uint16_t reference(int64_t elapsed, int64_t duration)
+{
+    int64_t clamped = std::clamp<int64_t>(elapsed, 0, duration);
+    return static_cast<uint16_t>(std::floor(static_cast<double>(clamped * 65535) / static_cast<double>(duration)));
+}
+
+bool check(int64_t start, int64_t elapsed, int64_t duration)
+{
+    checked++;
+    uint16_t expected = reference(elapsed, duration);
+    uint16_t actual = Alarm::sunrise_progress(start + elapsed, start, start + duration);
+    if (actual == expected)
+        return true;
+    printf("MISMATCH start %" PRId64 " elapsed %" PRId64 " duration %" PRId64 ": %u, expected %u\n", start, elapsed,
+           duration, actual, expected);
+    return false;
+}
+
+} // namespace
+
+int main()
+{
+    const int64_t starts[] = {0, 1700000000000LL, 4102444800000LL}; // 1970, 2023, 2100
+
+    for (int64_t start : starts) {
+        // Every millisecond of short windows, one past each end included
+        for (int64_t duration = 1; duration <= 1500; duration++)
+            for (int64_t elapsed = -1; elapsed <= duration + 1; elapsed++)
+                if (!check(start, elapsed, duration))
+                    return 1;
+
+        // Every whole-minute window the settings allow (ramp up to 255 minutes), at
+        // 4099 points each plus the values around every step of the 16-bit output
+        for (int64_t minutes = 1; minutes <= 255; minutes++) {
+            const int64_t duration = minutes * 60 * 1000;
+            const int64_t step = std::max<int64_t>(duration / 4099, 1);
+            for (int64_t elapsed = -step; elapsed <= duration + step; elapsed += step)
+                if (!check(start, elapsed, duration))
+                    return 1;
+            for (int64_t q = 1; q < 65535; q += 97) {
+                const int64_t edge = (q * duration + 65534) / 65535; // first elapsed reaching q
+                for (int64_t elapsed = edge - 1; elapsed <= edge; elapsed++)
+                    if (!check(start, elapsed, duration))
+                        return 1;
+            }
+        }
+    }
+
+    // The default 30 minute ramp, every millisecond
+    const int64_t duration = 30 * 60 * 1000;
+    for (int64_t elapsed = 0; elapsed <= duration; elapsed++)
+        if (!check(starts[1], elapsed, duration))
+            return 1;
+
+    printf("sunrise_progress: %" PRIu64 " values bit-identical to the reference\n", checked);
+    return 0;
+}